@@ -0,0 +1,143 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  cpu_features.h
+**
+** Notes:   Runtime detection of optional x86 instruction set extensions
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_FEATURES_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+//Allows a function to use instructions beyond the compiler baseline, callers must check cpu_features_get() first
+#if defined(CPU_FEATURES_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_FEATURES_TARGET(features) __attribute__((target(features)))
+#else
+#define CPU_FEATURES_TARGET(features)
+#endif
+
+/******************************************************************************/
+// Enum typedefs
+/******************************************************************************/
+enum cpu_feature_t {
+    CPU_FEATURE_SSSE3 = 0x01,
+    CPU_FEATURE_SSE4_1 = 0x02,
+    CPU_FEATURE_AVX2 = 0x04,
+    CPU_FEATURE_SHA = 0x08,
+};
+
+/******************************************************************************/
+// Global/Static Variable Declarations
+/******************************************************************************/
+//Features set here are not used even if the CPU has them, the tests use this to check the accelerated paths against the portable ones
+inline uint32_t cpu_features_disabled = 0;
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+static inline uint32_t cpu_features_detect()
+{
+    uint32_t features = 0;
+
+#if defined(CPU_FEATURES_X86)
+    uint32_t registers[4] = {0, 0, 0, 0};
+    uint32_t max_leaf;
+    bool ymm_enabled = false;
+
+#if defined(_MSC_VER)
+    __cpuid((int *)registers, 0);
+    max_leaf = registers[0];
+    __cpuid((int *)registers, 1);
+#else
+    max_leaf = __get_cpuid_max(0, nullptr);
+    __cpuid(1, registers[0], registers[1], registers[2], registers[3]);
+#endif
+
+    if (registers[2] & (1 << 9))
+    {
+        features |= CPU_FEATURE_SSSE3;
+    }
+
+    if (registers[2] & (1 << 19))
+    {
+        features |= CPU_FEATURE_SSE4_1;
+    }
+
+    //AVX registers can only be used if the OS saves them (OSXSAVE set and XCR0 has SSE and AVX state)
+    if ((registers[2] & (1 << 27)) && (registers[2] & (1 << 28)))
+    {
+#if defined(_MSC_VER)
+        ymm_enabled = ((_xgetbv(0) & 0x06) == 0x06);
+#else
+        uint32_t xcr0_low;
+        uint32_t xcr0_high;
+
+        __asm__ volatile ("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+        ymm_enabled = ((xcr0_low & 0x06) == 0x06);
+#endif
+    }
+
+    if (max_leaf >= 7)
+    {
+#if defined(_MSC_VER)
+        __cpuidex((int *)registers, 7, 0);
+#else
+        __cpuid_count(7, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+
+        if (ymm_enabled == true && (registers[1] & (1 << 5)))
+        {
+            features |= CPU_FEATURE_AVX2;
+        }
+
+        if (registers[1] & (1 << 29))
+        {
+            features |= CPU_FEATURE_SHA;
+        }
+    }
+#endif
+
+    return features;
+}
+
+static inline uint32_t cpu_features_get()
+{
+    static const uint32_t features = cpu_features_detect();
+
+    return (features & ~cpu_features_disabled);
+}
+
+#endif // CPU_FEATURES_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
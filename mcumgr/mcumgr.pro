@@ -74,10 +74,32 @@ CONFIG(release, debug|release) {
 
 contains(DEFINES, PLUGIN_MCUMGR_TRANSPORT_UART) {
     SOURCES += \
-	smp_uart.cpp
+	smp_uart.cpp \
+	smp_uart_base64.cpp \
+	smp_uart_crc16.cpp \
+	smp_uart_framer.cpp \
+	smp_uart_framer_cobs.cpp \
+	smp_uart_framer_console.cpp \
+	smp_uart_worker.cpp
 
     HEADERS += \
-	smp_uart.h
+	cpu_features.h \
+	smp_uart.h \
+	smp_uart_base64.h \
+	smp_uart_crc16.h \
+	smp_uart_framer.h \
+	smp_uart_framer_cobs.h \
+	smp_uart_framer_console.h \
+	smp_uart_message_queue.h \
+	smp_uart_worker.h
+
+    linux {
+	SOURCES += \
+	    smp_uart_linux.cpp
+
+	HEADERS += \
+	    smp_uart_linux.h
+    }
 }
 
 contains(DEFINES, PLUGIN_MCUMGR_TRANSPORT_BLUETOOTH) {
@@ -21,35 +21,67 @@
 **
 *******************************************************************************/
 #include "smp_uart.h"
-#include <crc16.h>
-#include <math.h>
+#include <string.h>
+
+static const uint16_t send_buffer_size = 4096;
+static const uint8_t message_pool_size = 4;
 
 smp_uart::smp_uart(QObject *parent)
 {
     Q_UNUSED(parent);
 
-    //connect(&serial_port, SIGNAL(bytesWritten(qint64)));
-    //connect(&serial_port, SIGNAL(aboutToClose());
-    QObject::connect(&serial_port, SIGNAL(readyRead()), this, SLOT(serial_read()));
-    QObject::connect(&serial_port, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(serial_error(QSerialPort::SerialPortError)));
-
     serial_config_set = false;
+    send_buffer.reserve(send_buffer_size);
+    memset(&dispatch_latency, 0, sizeof(dispatch_latency));
+    memset(&round_trip, 0, sizeof(round_trip));
+    request_pending = false;
+    request_retransmitted = false;
+
+    //Worker has no parent so that it can be moved to the I/O thread
+    framer = smp_uart_framer_create(SMP_UART_FRAMING_CONSOLE, smp_uart_line_size_default);
+    worker = new smp_uart_worker(&receive_queue);
+    io_thread = nullptr;
+
+    QObject::connect(worker, SIGNAL(messages_waiting()), this, SLOT(worker_messages_waiting()));
+    QObject::connect(worker, SIGNAL(error(int)), this, SLOT(worker_error(int)));
 }
 
 smp_uart::~smp_uart()
 {
-    QObject::disconnect(&serial_port, SIGNAL(readyRead()), this, SLOT(serial_read()));
-    QObject::disconnect(&serial_port, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(serial_error(QSerialPort::SerialPortError)));
+    QObject::disconnect(worker, SIGNAL(messages_waiting()), this, SLOT(worker_messages_waiting()));
+    QObject::disconnect(worker, SIGNAL(error(int)), this, SLOT(worker_error(int)));
 
-    if (serial_port.isOpen())
+    if (io_thread != nullptr)
     {
-        serial_port.close();
+        //Bring the worker back to this thread so that it can be deleted once the I/O thread has stopped
+        QThread *owner_thread = this->thread();
+
+        worker_run([this, owner_thread]()
+        {
+            worker->close();
+            worker->moveToThread(owner_thread);
+        });
+
+        io_thread->quit();
+        io_thread->wait();
+        delete io_thread;
+        io_thread = nullptr;
+    }
+
+    delete worker;
+    delete framer;
+
+    while (message_pool.isEmpty() == false)
+    {
+        delete message_pool.takeLast();
     }
 }
 
 int smp_uart::connect(void)
 {
-    if (serial_port.isOpen() == true)
+    int result;
+
+    if (worker->is_open() == true)
     {
         return SMP_TRANSPORT_ERROR_ALREADY_CONNECTED;
     }
@@ -59,56 +91,56 @@ int smp_uart::connect(void)
         return SMP_TRANSPORT_ERROR_INVALID_CONFIGURATION;
     }
 
-    //Port selected: setup serial port
-    serial_port.setPortName(serial_config.port_name);
-    serial_port.setBaudRate(serial_config.baud);
-    serial_port.setDataBits(serial_config.data_bits == SMP_UART_DATA_BITS_8 ? QSerialPort::Data8 : QSerialPort::Data7);
-    serial_port.setStopBits((serial_config.stop_bits == SMP_UART_STOP_BITS_1 ? QSerialPort::OneStop : (serial_config.stop_bits == SMP_UART_STOP_BITS_1_AND_HALF ? QSerialPort::OneAndHalfStop : QSerialPort::TwoStop)));
-    serial_port.setParity((serial_config.parity == SMP_UART_PARITY_NONE ? QSerialPort::NoParity : (serial_config.parity == SMP_UART_PARITY_EVEN ? QSerialPort::EvenParity : (serial_config.parity == SMP_UART_PARITY_ODD ? QSerialPort::OddParity : (serial_config.parity == SMP_UART_PARITY_SPACE ? QSerialPort::SpaceParity : QSerialPort::MarkParity)))));
-    serial_port.setFlowControl((serial_config.flow_control == SMP_UART_FLOW_CONTROL_NONE ? QSerialPort::NoFlowControl : (serial_config.flow_control == SMP_UART_FLOW_CONTROL_HARDWARE ? QSerialPort::HardwareControl : QSerialPort::SoftwareControl)));
-
-    if (serial_port.open(QIODevice::ReadWrite))
+    if (serial_config.io_thread == true && io_thread == nullptr)
     {
-        //Successful, set RTS to be asserted if hardware flow control is not used
-        if (serial_config.flow_control != SMP_UART_FLOW_CONTROL_HARDWARE)
-        {
-            serial_port.setRequestToSend(true);
-        }
-
-        return SMP_TRANSPORT_ERROR_OK;
+        //Once started, the I/O thread is kept for the lifetime of the transport
+        io_thread = new QThread();
+        io_thread->setObjectName("smp_uart_io");
+        worker->moveToThread(io_thread);
+        io_thread->start(QThread::HighPriority);
     }
-    else
+
+    memset(&dispatch_latency, 0, sizeof(dispatch_latency));
+    memset(&round_trip, 0, sizeof(round_trip));
+    request_pending = false;
+    request_retransmitted = false;
+
+    worker_run([this, &result]()
     {
-        //Error whilst opening
-        //ui->statusBar->showMessage("Error: ");
-        //ui->statusBar->showMessage(ui->statusBar->currentMessage().append(serial_port.errorString()));
-    }
+        result = worker->open(&serial_config);
+    });
 
-    return SMP_TRANSPORT_ERROR_OPEN_FAILED;
+    return result;
 }
 
 int smp_uart::disconnect(bool force)
 {
     Q_UNUSED(force);
 
-    if (serial_port.isOpen() == false)
+    if (worker->is_open() == false)
     {
         return SMP_TRANSPORT_ERROR_NOT_CONNECTED;
     }
 
-    SerialData.clear();
-    SMPBuffer.clear();
-    SMPBufferActualData.clear();
-    SMPWaitingForContinuation = false;
-    waiting_packet_length = 0;
-    serial_port.close();
+    worker_run([this]()
+    {
+        worker->close();
+    });
+
+    //Deliver anything which was received before the port was closed
+    worker_messages_waiting();
+
+    if (serial_config.latency_statistics == true)
+    {
+        report_latency();
+    }
 
     return SMP_TRANSPORT_ERROR_OK;
 }
 
 int smp_uart::is_connected()
 {
-    if (serial_port.isOpen() == true)
+    if (worker->is_open() == true)
     {
         return 1;
     }
@@ -118,261 +150,266 @@ int smp_uart::is_connected()
 
 void smp_uart::data_received(QByteArray *message)
 {
-    smp_message full_message;
-    full_message.append(message);
-
-    if (full_message.is_valid())
-    {
-        emit receive_waiting(&full_message);
-        full_message.clear();
-    }
-}
-
-void smp_uart::serial_read()
-{
-    SerialData.append(serial_port.readAll());
+    smp_message *full_message = message_pool_take();
 
-    //Search for SMP packets
-    int32_t pos = SerialData.indexOf(smp_first_header);
-    int32_t pos_other = SerialData.indexOf(smp_continuation_header);
-    int32_t posA = SerialData.indexOf(0x0a, pos + 2);
-    int32_t posA_other = SerialData.indexOf(0x0a, pos_other + 2);
+    //The frame decoder has already reassembled the message, it is copied once more into the SMP message here
+    full_message->append(message);
 
-    while ((pos != -1 && posA != -1) || (pos_other != -1 && posA_other != -1))
-//        while (pos != -1 && posA != -1 /*&& SMPWaitingForContinuation == false*/)
+    if (full_message->is_valid())
     {
-        if (pos >= 0 && (pos_other == -1 || pos < pos_other))
+        if (request_pending == true && request_retransmitted == false)
         {
-            //Start
-            //Check this header
-            SMPBuffer.clear();
-#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
-            SMPBuffer = QByteArray::fromBase64(SerialData.mid((pos + 2), (posA - pos - 2)), QByteArray::AbortOnBase64DecodingErrors);
-#else
-            SMPBuffer = QByteArray::fromBase64(SerialData.mid((pos + 2), (posA - pos - 2)));
-#endif
-
-            if (SMPBuffer.length() == 0)
-            {
-                log_error() << "Failed decoding base64";
-            }
-            else if (SMPBuffer.length() > 2)
-            {
-                //Check length
-                waiting_packet_length = ((uint16_t)SMPBuffer[0]) << 8;
-                waiting_packet_length |= ((uint16_t)SMPBuffer[1] & 0xff);
-                SMPBuffer.remove(0, 2);
-                if (SMPBuffer.length() >= (waiting_packet_length))
-                {
-                    //We have a full packet, check the checksum
-                    uint16_t crc = crc16(&SMPBuffer, 0, SMPBuffer.length() - 2, 0x1021, 0, true);
-                    uint16_t message_crc = ((uint16_t)SMPBuffer[(SMPBuffer.length() - 2)]) << 8;
-                    message_crc |= SMPBuffer[(SMPBuffer.length() - 1)] & 0xff;
-
-                    if (crc == message_crc)
-                    {
-                        //Good to parse message after removing CRC
-                        SMPBuffer.remove((SMPBuffer.length() - 2), 2);
-                        data_received(&SMPBuffer);
-                    }
-                    else
-                    {
-                        //CRC failure
-                        log_error() << "CRC failure, expected " << message_crc << " but got " << crc;
-                    }
-                }
-                else
-                {
-                    //More data expected in another packet
-                    SMPWaitingForContinuation = true;
-                    SMPBufferActualData = SMPBuffer;
-                }
-            }
+            //Responses to retransmitted requests are not timed, it is not known which transmission they answer (Karn)
+            qint64 elapsed = receive_queue.now_ns() - request_sent_ns;
 
-            SerialData.remove(pos, (posA - pos + 1));
+            round_trip.last_ns = elapsed;
+            round_trip.total_ns += elapsed;
 
-            pos = SerialData.indexOf(smp_first_header);
-            posA = SerialData.indexOf(0x0a, pos + 2);
-            pos_other = SerialData.indexOf(smp_continuation_header);
-            posA_other = SerialData.indexOf(0x0a, pos_other + 2);
-        }
-        else if (SMPWaitingForContinuation == true)
-        {
-            //Continuation
-            //Check this header
-            SMPBuffer.clear();
-#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
-            SMPBuffer = QByteArray::fromBase64(SerialData.mid((pos_other + 2), (posA_other - pos_other - 2)), QByteArray::AbortOnBase64DecodingErrors);
-#else
-            SMPBuffer = QByteArray::fromBase64(SerialData.mid((pos_other + 2), (posA_other - pos_other - 2)));
-#endif
-
-            if (SMPBuffer.length() == 0)
+            if (round_trip.samples == 0 || elapsed < round_trip.minimum_ns)
             {
-                log_error() << "Failed decoding base64";
+                round_trip.minimum_ns = elapsed;
             }
-            else if (SMPBuffer.length() > 0)
-            {
-                //Check length
-                SMPBufferActualData.append(SMPBuffer);
-                if (SMPBufferActualData.length() >= (waiting_packet_length /*+ 2*/))
-                {
-                    //We have a full packet, check the checksum
-                    uint16_t crc = crc16(&SMPBufferActualData, 0, SMPBufferActualData.length() - 2, 0x1021, 0, true);
-                    uint16_t message_crc = ((uint16_t)SMPBufferActualData[(SMPBufferActualData.length() - 2)]) << 8;
-                    message_crc |= SMPBufferActualData[(SMPBufferActualData.length() - 1)] & 0xff;
-
-                    if (crc == message_crc)
-                    {
-                        //Good to parse message after removing CRC
-                        SMPBufferActualData.remove((SMPBufferActualData.length() - 2), 2);
-                        data_received(&SMPBufferActualData);
-                    }
-                    else
-                    {
-                        //CRC failure
-                        log_error() << "CRC failure, expected " << message_crc << " but got " << crc;
-                    }
-
-                    SMPBufferActualData.clear();
-                    SMPWaitingForContinuation = false;
-                }
-                else
-                {
-                    //More data expected in another packet
-                    SMPWaitingForContinuation = true;
-                }
-            }
-
-            SerialData.remove(pos_other, (posA_other - pos_other + 1));
 
-            pos = SerialData.indexOf(smp_first_header);
-            if (pos == -1)
-            {
-                posA = -1;
-            }
-            else
-            {
-                posA = SerialData.indexOf(0x0a, pos + 2);
-            }
-            pos_other = SerialData.indexOf(smp_continuation_header);
-            if (pos_other == -1)
+            if (elapsed > round_trip.maximum_ns)
             {
-                posA_other = -1;
-            }
-            else
-            {
-                posA_other = SerialData.indexOf(0x0a, pos_other + 2);
+                round_trip.maximum_ns = elapsed;
             }
+
+            ++round_trip.samples;
+            log_debug() << "SMP round trip time: " << (elapsed / 1000) << "us";
+            emit round_trip_sample((uint32_t)(elapsed / 1000));
         }
+
+        request_pending = false;
+
+        emit receive_waiting(full_message);
     }
 
-    if (SerialData.length() > 10 && SerialData.indexOf(smp_first_header) == -1 && SerialData.indexOf(smp_continuation_header) == -1)
+    message_pool_return(full_message);
+}
+
+smp_message *smp_uart::message_pool_take()
+{
+    if (message_pool.isEmpty() == true)
     {
-        log_error() << "Cleared garbage data in UART SMP transport buffer";
-        SerialData.clear();
+        return new smp_message();
     }
+
+    return message_pool.takeLast();
 }
 
-smp_transport_error_t smp_uart::send(smp_message *message)
+void smp_uart::message_pool_return(smp_message *message)
 {
-    //127 bytes = 3 + base 64 message
-    //base64 = 4 bytes output per 3 byte input
-    QByteArray output;
-    uint16_t size = message->size();
-    size += 2;
-    output.append((uint8_t)((size & 0xff00) >> 8));
-    output.append((uint8_t)(size & 0xff));
-    uint16_t crc = crc16(message->data(), 0, message->size(), 0x1021, 0, true);
-
-    QByteArray inbase;
-    inbase.append(smp_first_header);
-    int32_t pos = 0;
-
-    while (pos < (message->size() + 1))
+    if (message_pool.length() >= message_pool_size)
     {
-        /* Chunking required */
-        int16_t chunk_size = 93 - output.length();
+        delete message;
+        return;
+    }
 
-        if ((chunk_size + pos) > message->size())
-        {
-            chunk_size = message->size() - pos;
+    message->clear();
+    message_pool.append(message);
+}
 
-            if (chunk_size == 0)
-            {
-                goto end;
-            }
-        }
+void smp_uart::worker_run(std::function<void()> function)
+{
+    if (io_thread == nullptr)
+    {
+        function();
+    }
+    else
+    {
+        QMetaObject::invokeMethod(worker, function, Qt::BlockingQueuedConnection);
+    }
+}
+
+void smp_uart::worker_messages_waiting()
+{
+    QByteArray *message;
+    qint64 queued_ns;
 
-        output.append(message->data()->mid(pos, chunk_size));
-        pos += chunk_size;
+    receive_queue.clear_notify();
 
-        if (pos == message->size() && (93 - chunk_size) > 2)
+    while ((message = receive_queue.front(&queued_ns)) != nullptr)
+    {
+        ++dispatch_latency.samples;
+        dispatch_latency.total_ns += queued_ns;
+
+        if (queued_ns > dispatch_latency.maximum_ns)
         {
-end:
-            output.append((uint8_t)((crc & 0xff00) >> 8));
-            output.append((uint8_t)(crc & 0xff));
-            pos += 2;
+            dispatch_latency.maximum_ns = queued_ns;
         }
 
-        inbase.append(output.toBase64());
-        inbase.append((uint8_t)0x0a);
-        serial_port.write(inbase);
+        data_received(message);
+        receive_queue.pop();
+    }
+}
 
-        inbase.clear();
-        inbase.append(smp_continuation_header);
-        output.clear();
+void smp_uart::worker_send_waiting()
+{
+    //Runs on the I/O thread, the worker copies each frame into its write queue so the entry can be released straight away
+    QByteArray *frame;
+    qint64 queued_ns;
+
+    send_queue.clear_notify();
+
+    while ((frame = send_queue.front(&queued_ns)) != nullptr)
+    {
+        worker->write(*frame);
+        send_queue.pop();
     }
+}
 
-    return SMP_TRANSPORT_ERROR_OK;
+void smp_uart::worker_error(int error)
+{
+    emit smp_transport::error(error);
 }
 
-uint16_t smp_uart::max_message_data_size(uint16_t mtu)
+void smp_uart::report_latency()
 {
-    float available_mtu = mtu;
-    int packets = ceil(available_mtu / 124.0);
+    struct smp_uart_latency_t event_loop_latency;
+    uint32_t maximum_write_queue_depth;
+    uint32_t line_gap_us;
 
-    //Convert to number of base64 encoded bytes
-    available_mtu = available_mtu * 3.0 / 4.0;
+    worker_run([this, &event_loop_latency, &maximum_write_queue_depth, &line_gap_us]()
+    {
+        worker->event_loop_latency(&event_loop_latency);
+        worker->pacing_statistics(&maximum_write_queue_depth, &line_gap_us);
+    });
+
+    log_information() << "UART " << (io_thread != nullptr ? "I/O thread" : "main thread") << " event loop latency: average " << (event_loop_latency.samples > 0 ? (event_loop_latency.total_ns / event_loop_latency.samples / 1000) : 0) << "us, maximum " << (event_loop_latency.maximum_ns / 1000) << "us over " << event_loop_latency.samples << " samples";
+    log_information() << "SMP round trip time: average " << (round_trip.samples > 0 ? (round_trip.total_ns / round_trip.samples / 1000) : 0) << "us, minimum " << (round_trip.minimum_ns / 1000) << "us, maximum " << (round_trip.maximum_ns / 1000) << "us over " << round_trip.samples << " commands, " << round_trip.retransmissions << " retransmissions";
+    log_information() << "UART write queue maximum depth: " << maximum_write_queue_depth << " bytes, final line gap: " << line_gap_us << "us";
+    log_information() << "UART message dispatch latency: average " << (dispatch_latency.samples > 0 ? (dispatch_latency.total_ns / dispatch_latency.samples / 1000) : 0) << "us, maximum " << (dispatch_latency.maximum_ns / 1000) << "us over " << dispatch_latency.samples << " messages";
+}
+
+smp_transport_error_t smp_uart::send(smp_message *message)
+{
+    //Only the same message sent again whilst still waiting for its response is a retry, a new request has a new sequence number
+    request_retransmitted = (request_pending == true && last_request.length() == message->size() && memcmp(last_request.constData(), message->data()->constData(), last_request.length()) == 0);
 
-    //Remove packet length and CRC (2 bytes each)
-    available_mtu -= 4.0;
+    if (request_retransmitted == true)
+    {
+        ++round_trip.retransmissions;
 
-    //Remove header and footer of each packet
-    available_mtu -= (float)packets * 3.0;
+        worker_run([this]()
+        {
+            worker->request_retransmitted();
+        });
 
-    //Remove possible padding bytes for narrow final packets
-    if (((uint16_t)available_mtu % 93) >= 91)
+        emit request_retry();
+    }
+    else
     {
-        available_mtu -= 3.0;
+        if (request_pending == true)
+        {
+            //The previous request was given up on without a response
+            worker_run([this]()
+            {
+                worker->request_abandoned();
+            });
+        }
+
+        //Kept in a reused buffer so that the comparison does not allocate per request
+        last_request.resize(message->size());
+        memcpy(last_request.data(), message->data()->constData(), message->size());
     }
-    else if (((uint16_t)available_mtu % 93) >= 88)
+
+    request_sent_ns = receive_queue.now_ns();
+    request_pending = true;
+
+    if (io_thread == nullptr)
     {
-        available_mtu -= 1.0;
+        //Frame the whole message into the reused send buffer and hand it to the port in one write
+        framer->encode((const uint8_t *)message->data()->constData(), message->size(), &send_buffer);
+        worker->write(send_buffer);
     }
+    else
+    {
+        //Frame into a send queue entry, which keeps its allocation between messages, and have the I/O thread write it out
+        QByteArray *frame = send_queue.push_entry();
+
+        if (frame == nullptr)
+        {
+            //Only reached with a full queue, the copy is queued behind the pending drain so the order is kept
+            QByteArray overflow_frame;
+
+            framer->encode((const uint8_t *)message->data()->constData(), message->size(), &overflow_frame);
+            QMetaObject::invokeMethod(worker, [this, overflow_frame]()
+            {
+                worker->write(overflow_frame);
+            }, Qt::QueuedConnection);
+        }
+        else
+        {
+            framer->encode((const uint8_t *)message->data()->constData(), message->size(), frame);
 
-    return (uint16_t)available_mtu;
+            if (send_queue.push_commit() == true)
+            {
+                QMetaObject::invokeMethod(worker, [this]()
+                {
+                    worker_send_waiting();
+                }, Qt::QueuedConnection);
+            }
+        }
+    }
+
+    return SMP_TRANSPORT_ERROR_OK;
+}
+
+uint16_t smp_uart::max_message_data_size(uint16_t mtu)
+{
+    //MTU is the size of the framed message on the wire, so this depends upon the line size in use
+    return framer->maximum_message_size(mtu);
+}
+
+uint32_t smp_uart::framed_size(uint16_t message_size)
+{
+    //Inverse of max_message_data_size(), gives the MTU needed to carry a message of this size
+    return framer->encoded_size(message_size);
 }
 
-void smp_uart::serial_error(QSerialPort::SerialPortError error)
+void smp_uart::request_abandoned()
 {
-    if (error == QSerialPort::NoError)
+    if (request_pending == false)
     {
         return;
     }
 
-    log_error() << "Serial port error: " << error;
-    emit smp_transport::error(error);
+    request_pending = false;
+    request_retransmitted = false;
 
-    if (serial_port.isOpen())
+    worker_run([this]()
     {
-        serial_port.close();
-    }
+        worker->request_abandoned();
+    });
+}
+
+void smp_uart::round_trip_time(struct smp_uart_round_trip_t *round_trip_output)
+{
+    *round_trip_output = round_trip;
+}
+
+uint32_t smp_uart::baud_rate(bool *exact)
+{
+    //Only changes when the port is opened, which is a blocking call, so it can be read from this thread
+    uint32_t actual_baud = worker->baud_rate();
+
+    *exact = (actual_baud == serial_config.baud);
+
+    return actual_baud;
+}
+
+uint32_t smp_uart::write_queue_depth()
+{
+    //Bytes waiting to be paced out plus those buffered by the serial port, safe to call from any thread
+    return worker->write_queue_depth();
 }
 
 int smp_uart::set_connection_config(struct smp_uart_config_t *configuration)
 {
-    if (serial_port.isOpen() == true)
+    smp_uart_framer *new_framer;
+
+    if (worker->is_open() == true)
     {
         return SMP_TRANSPORT_ERROR_ALREADY_CONNECTED;
     }
@@ -383,6 +420,24 @@ int smp_uart::set_connection_config(struct smp_uart_config_t *configuration)
     serial_config.parity = configuration->parity;
     serial_config.data_bits = configuration->data_bits;
     serial_config.stop_bits = configuration->stop_bits;
+    serial_config.framing = configuration->framing;
+    serial_config.line_size = configuration->line_size;
+    serial_config.io_thread = configuration->io_thread;
+    serial_config.latency_statistics = configuration->latency_statistics;
+    serial_config.low_latency = configuration->low_latency;
+    serial_config.line_gap = configuration->line_gap;
+
+    new_framer = smp_uart_framer_create(configuration->framing, configuration->line_size);
+
+    if (new_framer == nullptr)
+    {
+        serial_config_set = false;
+        return SMP_TRANSPORT_ERROR_INVALID_CONFIGURATION;
+    }
+
+    delete framer;
+    framer = new_framer;
+
     serial_config_set = true;
 
     return SMP_TRANSPORT_ERROR_OK;
@@ -28,9 +28,15 @@
 /******************************************************************************/
 #include <QObject>
 #include <QSerialPort>
+#include <QThread>
+#include <functional>
 #include <smp_transport.h>
 #include <smp_message.h>
 #include <debug_logger.h>
+#include "smp_uart_framer.h"
+#include "smp_uart_framer_console.h"
+#include "smp_uart_message_queue.h"
+#include "smp_uart_worker.h"
 
 /******************************************************************************/
 // Enum typedefs
@@ -78,6 +84,21 @@ struct smp_uart_config_t {
     enum smp_uart_parity_t parity;
     enum smp_uart_data_bits_t data_bits;
     enum smp_uart_stop_bits_t stop_bits;
+    enum smp_uart_framing_t framing;
+    uint16_t line_size;
+    bool io_thread;
+    bool latency_statistics;
+    bool low_latency;
+    uint16_t line_gap;
+};
+
+struct smp_uart_round_trip_t {
+    uint32_t samples;
+    qint64 last_ns;
+    qint64 minimum_ns;
+    qint64 maximum_ns;
+    qint64 total_ns;
+    uint32_t retransmissions;
 };
 
 /******************************************************************************/
@@ -97,28 +118,47 @@ public:
     smp_transport_error_t send(smp_message *message) override;
     uint16_t max_message_data_size(uint16_t mtu) override;
     QString to_error_string(int error_code) override;
+    void round_trip_time(struct smp_uart_round_trip_t *round_trip);
+    uint32_t baud_rate(bool *exact);
+    uint32_t write_queue_depth();
+    uint32_t framed_size(uint16_t message_size);
+
+    //Must be called when a request is given up on without a response, so that the next request is not taken for a retry of it
+    void request_abandoned();
 
 private:
     void data_received(QByteArray *message);
+    smp_message *message_pool_take();
+    void message_pool_return(smp_message *message);
+    void worker_run(std::function<void()> function);
+    void worker_send_waiting();
+    void report_latency();
 
 signals:
     void serial_write(QByteArray *data);
+    void round_trip_sample(uint32_t rtt_us);
+    void request_retry();
 
 private slots:
-    void serial_read();
-    void serial_error(QSerialPort::SerialPortError error);
+    void worker_messages_waiting();
+    void worker_error(int error);
 
 private:
     struct smp_uart_config_t serial_config;
     bool serial_config_set;
-    QSerialPort serial_port;
-    QByteArray SerialData;
-    QByteArray SMPBuffer;
-    QByteArray SMPBufferActualData;
-    bool SMPWaitingForContinuation = false;
-    const QByteArray smp_first_header = QByteArrayLiteral("\x06\x09");
-    const QByteArray smp_continuation_header = QByteArrayLiteral("\x04\x14");
-    uint16_t waiting_packet_length = 0;
+    QByteArray send_buffer;
+    QByteArray last_request;
+    smp_uart_framer *framer;
+    QList<smp_message *> message_pool;
+    smp_uart_message_queue receive_queue;
+    smp_uart_message_queue send_queue;
+    smp_uart_worker *worker;
+    QThread *io_thread;
+    struct smp_uart_latency_t dispatch_latency;
+    struct smp_uart_round_trip_t round_trip;
+    qint64 request_sent_ns;
+    bool request_pending;
+    bool request_retransmitted;
 };
 
 #endif // SMP_UART_H
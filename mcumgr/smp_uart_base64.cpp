@@ -0,0 +1,342 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_base64.cpp
+**
+** Notes:   Base64 codec working on caller supplied buffers, with SSE4.1 and
+**          AVX2 paths selected at runtime
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_base64.h"
+#include "cpu_features.h"
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const uint8_t base64_invalid = 0xff;
+static const char base64_padding = '=';
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+struct base64_decode_table_t {
+    uint8_t value[256];
+};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static constexpr base64_decode_table_t base64_generate_decode_table()
+{
+    base64_decode_table_t table = {};
+    uint16_t i = 0;
+
+    while (i < 256)
+    {
+        table.value[i] = base64_invalid;
+        ++i;
+    }
+
+    i = 0;
+
+    while (i < 64)
+    {
+        table.value[(uint8_t)base64_alphabet[i]] = (uint8_t)i;
+        ++i;
+    }
+
+    return table;
+}
+
+static constexpr base64_decode_table_t base64_decode_table = base64_generate_decode_table();
+
+#if defined(CPU_FEATURES_X86)
+//Vector versions follow the approach of W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions"
+CPU_FEATURES_TARGET("ssse3,sse4.1")
+static inline __m128i base64_encode_translate_sse(__m128i input)
+{
+    //Input has 3 bytes spread over each 32-bit lane as [b1 b0 b2 b1], split into four 6-bit indices
+    const __m128i shift_lut = _mm_setr_epi8(('a' - 26), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('+' - 62), ('/' - 63), 'A', 0, 0);
+    __m128i indices = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)), _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+    __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+
+    reduced = _mm_or_si128(reduced, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, reduced), indices);
+}
+
+CPU_FEATURES_TARGET("ssse3,sse4.1")
+static uint32_t base64_encode_sse(const uint8_t *input, uint32_t length, char *output)
+{
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    uint32_t pos = 0;
+
+    //Each step reads 16 bytes and uses 12 of them
+    while ((length - pos) >= 16)
+    {
+        __m128i data = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(input + pos)), spread);
+
+        _mm_storeu_si128((__m128i *)output, base64_encode_translate_sse(data));
+        pos += 12;
+        output += 16;
+    }
+
+    return pos;
+}
+
+CPU_FEATURES_TARGET("avx2")
+static uint32_t base64_encode_avx2(const uint8_t *input, uint32_t length, char *output)
+{
+    const __m256i spread = _mm256_broadcastsi128_si256(_mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m256i shift_lut = _mm256_broadcastsi128_si256(_mm_setr_epi8(('a' - 26), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('0' - 52), ('+' - 62), ('/' - 63), 'A', 0, 0));
+    uint32_t pos = 0;
+
+    //Each step reads 28 bytes and uses 24 of them, 12 per 128-bit lane
+    while ((length - pos) >= 28)
+    {
+        __m256i data = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(input + pos))), _mm_loadu_si128((const __m128i *)(input + pos + 12)), 1);
+        __m256i indices;
+        __m256i reduced;
+
+        data = _mm256_shuffle_epi8(data, spread);
+        indices = _mm256_or_si256(_mm256_mulhi_epu16(_mm256_and_si256(data, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040)), _mm256_mullo_epi16(_mm256_and_si256(data, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010)));
+        reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        reduced = _mm256_or_si256(reduced, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+
+        _mm256_storeu_si256((__m256i *)output, _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, reduced), indices));
+        pos += 24;
+        output += 32;
+    }
+
+    return pos;
+}
+
+CPU_FEATURES_TARGET("ssse3,sse4.1")
+static uint32_t base64_decode_sse(const char *input, uint32_t length, uint8_t *output)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    const __m128i slash = _mm_set1_epi8('/');
+    uint32_t pos = 0;
+
+    //Each step stores 16 bytes of which 12 are valid, the remaining input guarantees the overrun is overwritten later
+    while ((length - pos) >= 24)
+    {
+        __m128i data = _mm_loadu_si128((const __m128i *)(input + pos));
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(data, 4), nibble_mask);
+        __m128i lo_nibbles = _mm_and_si128(data, nibble_mask);
+
+        if (_mm_testz_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles)) == 0)
+        {
+            //Invalid character, leave it for the scalar decoder to report
+            break;
+        }
+
+        data = _mm_add_epi8(data, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(data, slash), hi_nibbles)));
+        data = _mm_madd_epi16(_mm_maddubs_epi16(data, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *)output, _mm_shuffle_epi8(data, pack));
+        pos += 16;
+        output += 12;
+    }
+
+    return pos;
+}
+
+CPU_FEATURES_TARGET("avx2")
+static uint32_t base64_decode_avx2(const char *input, uint32_t length, uint8_t *output)
+{
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(_mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+    const __m256i lut_roll = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i pack = _mm256_broadcastsi128_si256(_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+    const __m256i slash = _mm256_set1_epi8('/');
+    uint32_t pos = 0;
+
+    //Each step stores 32 bytes of which 24 are valid, the remaining input guarantees the overrun is overwritten later
+    while ((length - pos) >= 48)
+    {
+        __m256i data = _mm256_loadu_si256((const __m256i *)(input + pos));
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(data, 4), nibble_mask);
+        __m256i lo_nibbles = _mm256_and_si256(data, nibble_mask);
+
+        if (_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), _mm256_shuffle_epi8(lut_hi, hi_nibbles)) == 0)
+        {
+            //Invalid character, leave it for the scalar decoder to report
+            break;
+        }
+
+        data = _mm256_add_epi8(data, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(data, slash), hi_nibbles)));
+        data = _mm256_madd_epi16(_mm256_maddubs_epi16(data, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+        data = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(data, pack), join);
+        _mm256_storeu_si256((__m256i *)output, data);
+        pos += 32;
+        output += 24;
+    }
+
+    return pos;
+}
+#endif
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+uint32_t smp_uart_base64_encode(const uint8_t *input, uint32_t length, char *output)
+{
+    char *start = output;
+    uint32_t pos = 0;
+
+#if defined(CPU_FEATURES_X86)
+    uint32_t features = cpu_features_get();
+
+    if (features & CPU_FEATURE_AVX2)
+    {
+        pos = base64_encode_avx2(input, length, output);
+    }
+    else if ((features & (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1)) == (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1))
+    {
+        pos = base64_encode_sse(input, length, output);
+    }
+
+    output += (pos / 3) * 4;
+#endif
+
+    while ((length - pos) >= 3)
+    {
+        uint32_t value = ((uint32_t)input[pos] << 16) | ((uint32_t)input[(pos + 1)] << 8) | input[(pos + 2)];
+
+        output[0] = base64_alphabet[(value >> 18)];
+        output[1] = base64_alphabet[((value >> 12) & 0x3f)];
+        output[2] = base64_alphabet[((value >> 6) & 0x3f)];
+        output[3] = base64_alphabet[(value & 0x3f)];
+        pos += 3;
+        output += 4;
+    }
+
+    if ((length - pos) > 0)
+    {
+        uint32_t value = ((uint32_t)input[pos] << 16);
+
+        if ((length - pos) == 2)
+        {
+            value |= ((uint32_t)input[(pos + 1)] << 8);
+        }
+
+        output[0] = base64_alphabet[(value >> 18)];
+        output[1] = base64_alphabet[((value >> 12) & 0x3f)];
+        output[2] = ((length - pos) == 2 ? base64_alphabet[((value >> 6) & 0x3f)] : base64_padding);
+        output[3] = base64_padding;
+        output += 4;
+    }
+
+    return (uint32_t)(output - start);
+}
+
+int32_t smp_uart_base64_decode(const char *input, uint32_t length, uint8_t *output)
+{
+    const uint8_t *table = base64_decode_table.value;
+    uint8_t *start = output;
+    uint32_t pos = 0;
+
+    //Strip padding, which is only valid at the end of a complete final block
+    if (length >= 4 && (length % 4) == 0 && input[(length - 1)] == base64_padding)
+    {
+        --length;
+
+        if (input[(length - 1)] == base64_padding)
+        {
+            --length;
+        }
+    }
+
+    if ((length % 4) == 1)
+    {
+        return -1;
+    }
+
+#if defined(CPU_FEATURES_X86)
+    uint32_t features = cpu_features_get();
+
+    if (features & CPU_FEATURE_AVX2)
+    {
+        pos = base64_decode_avx2(input, length, output);
+    }
+    else if ((features & (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1)) == (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1))
+    {
+        pos = base64_decode_sse(input, length, output);
+    }
+
+    output += (pos / 4) * 3;
+#endif
+
+    while ((length - pos) >= 4)
+    {
+        uint8_t a = table[(uint8_t)input[pos]];
+        uint8_t b = table[(uint8_t)input[(pos + 1)]];
+        uint8_t c = table[(uint8_t)input[(pos + 2)]];
+        uint8_t d = table[(uint8_t)input[(pos + 3)]];
+        uint32_t value;
+
+        if (((a | b | c | d) & 0xc0) != 0)
+        {
+            return -1;
+        }
+
+        value = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+        output[0] = (uint8_t)(value >> 16);
+        output[1] = (uint8_t)(value >> 8);
+        output[2] = (uint8_t)value;
+        pos += 4;
+        output += 3;
+    }
+
+    if ((length - pos) >= 2)
+    {
+        uint8_t a = table[(uint8_t)input[pos]];
+        uint8_t b = table[(uint8_t)input[(pos + 1)]];
+        uint8_t c = ((length - pos) == 3 ? table[(uint8_t)input[(pos + 2)]] : 0);
+
+        if (((a | b | c) & 0xc0) != 0)
+        {
+            return -1;
+        }
+
+        output[0] = (uint8_t)((a << 2) | (b >> 4));
+        ++output;
+
+        if ((length - pos) == 3)
+        {
+            output[0] = (uint8_t)((b << 4) | (c >> 2));
+            ++output;
+        }
+    }
+
+    return (int32_t)(output - start);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,55 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_base64.h
+**
+** Notes:   Base64 codec working on caller supplied buffers, with SSE4.1 and
+**          AVX2 paths selected at runtime
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_BASE64_H
+#define SMP_UART_BASE64_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+static inline uint32_t smp_uart_base64_encoded_size(uint32_t length)
+{
+    return ((length + 2) / 3) * 4;
+}
+
+static inline uint32_t smp_uart_base64_decoded_size_maximum(uint32_t length)
+{
+    return ((length + 3) / 4) * 3;
+}
+
+//Encodes length bytes with padding, output must hold smp_uart_base64_encoded_size(length) bytes, returns number of characters written
+uint32_t smp_uart_base64_encode(const uint8_t *input, uint32_t length, char *output);
+
+//Decodes padded or unpadded base64, output must hold smp_uart_base64_decoded_size_maximum(length) bytes, returns number of bytes written or -1 if input is not valid
+int32_t smp_uart_base64_decode(const char *input, uint32_t length, uint8_t *output);
+
+#endif // SMP_UART_BASE64_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,116 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_crc16.cpp
+**
+** Notes:   Table driven CRC-16/XMODEM (polynomial 0x1021, initial value 0)
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_crc16.h"
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+static const uint16_t crc16_polynomial = 0x1021;
+static const uint8_t crc16_slices = 8;
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+struct crc16_tables_t {
+    uint16_t table[crc16_slices][256];
+};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static constexpr crc16_tables_t crc16_generate_tables()
+{
+    crc16_tables_t tables = {};
+    uint16_t i = 0;
+
+    //Table 0 is the CRC of a single byte, each further table advances the previous one by another zero byte
+    while (i < 256)
+    {
+        uint16_t crc = (uint16_t)(i << 8);
+        uint8_t bit = 0;
+
+        while (bit < 8)
+        {
+            crc = ((crc & 0x8000) ? (uint16_t)((crc << 1) ^ crc16_polynomial) : (uint16_t)(crc << 1));
+            ++bit;
+        }
+
+        tables.table[0][i] = crc;
+        ++i;
+    }
+
+    i = 0;
+
+    while (i < 256)
+    {
+        uint8_t slice = 1;
+
+        while (slice < crc16_slices)
+        {
+            uint16_t previous = tables.table[(slice - 1)][i];
+
+            tables.table[slice][i] = (uint16_t)(previous << 8) ^ tables.table[0][(previous >> 8)];
+            ++slice;
+        }
+
+        ++i;
+    }
+
+    return tables;
+}
+
+static constexpr crc16_tables_t crc16_tables = crc16_generate_tables();
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+uint16_t smp_uart_crc16(const uint8_t *data, uint32_t length, uint16_t crc)
+{
+    const uint16_t (*table)[256] = crc16_tables.table;
+
+    //Slicing-by-8: fold 8 bytes per step using one lookup per byte
+    while (length >= crc16_slices)
+    {
+        crc ^= (uint16_t)(((uint16_t)data[0] << 8) | data[1]);
+        crc = table[7][(crc >> 8)] ^ table[6][(crc & 0xff)] ^ table[5][data[2]] ^ table[4][data[3]] ^ table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+        data += crc16_slices;
+        length -= crc16_slices;
+    }
+
+    while (length > 0)
+    {
+        crc = (uint16_t)(crc << 8) ^ table[0][((crc >> 8) ^ *data)];
+        ++data;
+        --length;
+    }
+
+    return crc;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,41 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_crc16.h
+**
+** Notes:   Table driven CRC-16/XMODEM (polynomial 0x1021, initial value 0)
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_CRC16_H
+#define SMP_UART_CRC16_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+//Returns the CRC of length bytes at data, a previous result can be passed in crc to continue over several spans
+uint16_t smp_uart_crc16(const uint8_t *data, uint32_t length, uint16_t crc = 0);
+
+#endif // SMP_UART_CRC16_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
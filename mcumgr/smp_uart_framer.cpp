@@ -0,0 +1,64 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_framer.cpp
+**
+** Notes:   Interface of the UART SMP frame encoders/decoders and the factory
+**          used to select one
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_framer.h"
+#include "smp_uart_framer_console.h"
+#include "smp_uart_framer_cobs.h"
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+smp_uart_framer *smp_uart_framer_create(enum smp_uart_framing_t framing, uint16_t line_size)
+{
+    switch (framing)
+    {
+        case SMP_UART_FRAMING_CONSOLE:
+        {
+            smp_uart_framer_console *framer = new smp_uart_framer_console();
+
+            if (framer->set_line_size(line_size) == false)
+            {
+                delete framer;
+                return nullptr;
+            }
+
+            return framer;
+        }
+        case SMP_UART_FRAMING_COBS:
+        {
+            return new smp_uart_framer_cobs();
+        }
+        default:
+        {
+            return nullptr;
+        }
+    };
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,91 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_framer.h
+**
+** Notes:   Interface of the UART SMP frame encoders/decoders and the factory
+**          used to select one
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_FRAMER_H
+#define SMP_UART_FRAMER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QByteArray>
+#include <stdint.h>
+
+/******************************************************************************/
+// Enum typedefs
+/******************************************************************************/
+enum smp_uart_framing_t {
+    SMP_UART_FRAMING_CONSOLE,
+    SMP_UART_FRAMING_COBS,
+
+    SMP_UART_FRAMING_COUNT
+};
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class smp_uart_framer
+{
+public:
+    smp_uart_framer()
+    {
+        error_count = 0;
+    }
+
+    virtual ~smp_uart_framer() {}
+
+    //Discards any partially received frame
+    virtual void reset() = 0;
+
+    //Consumes received data up to the end of a frame, returns the number of bytes used, message() is valid when message_complete is set
+    virtual uint32_t decode(const char *data, uint32_t length, bool *message_complete) = 0;
+
+    //Replaces the contents of output with the framed message
+    virtual void encode(const uint8_t *data, uint16_t length, QByteArray *output) = 0;
+
+    //Size on the wire of a framed message of length bytes, and the inverse
+    virtual uint32_t encoded_size(uint32_t length) = 0;
+    virtual uint16_t maximum_message_size(uint32_t encoded_length) = 0;
+
+    virtual QByteArray *message() = 0;
+
+    //Number of received frames discarded because they were corrupt (bad encoding, length or CRC)
+    uint32_t errors()
+    {
+        return error_count;
+    }
+
+protected:
+    uint32_t error_count;
+};
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+//Returns nullptr if the framing or line size is not valid, line size is only used by console framing
+smp_uart_framer *smp_uart_framer_create(enum smp_uart_framing_t framing, uint16_t line_size);
+
+#endif // SMP_UART_FRAMER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
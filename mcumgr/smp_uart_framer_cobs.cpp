@@ -0,0 +1,294 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_framer_cobs.cpp
+**
+** Notes:   Binary SMP framing for dedicated UARTs: COBS encoded message and
+**          CRC16, delimited by zero bytes
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_framer_cobs.h"
+#include "smp_uart_crc16.h"
+#include <debug_logger.h>
+#include <string.h>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+//A COBS block holds at most 254 non-zero bytes after its code byte
+static const uint8_t cobs_block_code_maximum = 0xff;
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static void cobs_close_block(uint8_t *output, uint32_t *output_pos, uint32_t *code_pos, uint8_t *code)
+{
+    output[*code_pos] = *code;
+    *code_pos = *output_pos;
+    ++*output_pos;
+    *code = 1;
+}
+
+static void cobs_encode_segment(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t *output_pos, uint32_t *code_pos, uint8_t *code)
+{
+    uint32_t pos = 0;
+
+    //Copies runs of non-zero bytes at a time, state is kept so that segments can be encoded back to back
+    while (pos < length)
+    {
+        uint32_t run = length - pos;
+        uint32_t space = cobs_block_code_maximum - *code;
+        const uint8_t *zero;
+
+        if (run > space)
+        {
+            run = space;
+        }
+
+        zero = (const uint8_t *)memchr(&input[pos], 0, run);
+
+        if (zero != nullptr)
+        {
+            run = (uint32_t)(zero - &input[pos]);
+        }
+
+        memcpy(&output[*output_pos], &input[pos], run);
+        *output_pos += run;
+        *code += run;
+        pos += run;
+
+        if (zero != nullptr)
+        {
+            //Zero byte is replaced by the code byte of the block it ends
+            cobs_close_block(output, output_pos, code_pos, code);
+            ++pos;
+        }
+        else if (*code == cobs_block_code_maximum)
+        {
+            cobs_close_block(output, output_pos, code_pos, code);
+        }
+    }
+}
+
+smp_uart_framer_cobs::smp_uart_framer_cobs()
+{
+    frame_buffer.reserve(512);
+    message_buffer.reserve(512);
+    reset();
+}
+
+void smp_uart_framer_cobs::reset()
+{
+    discarding = false;
+    frame_buffer.resize(0);
+    message_buffer.resize(0);
+}
+
+uint32_t smp_uart_framer_cobs::decode(const char *data, uint32_t length, bool *message_complete)
+{
+    const char *frame_end = (const char *)memchr(data, smp_uart_cobs_delimiter, length);
+    uint32_t frame_length;
+
+    *message_complete = false;
+
+    if (frame_end == nullptr)
+    {
+        //Partial frame, keep it until the delimiter arrives
+        if (discarding == false)
+        {
+            if ((frame_buffer.length() + length) > smp_uart_cobs_frame_size_maximum)
+            {
+                ++error_count;
+                log_error() << "Discarded over-length frame in UART SMP transport";
+                frame_buffer.resize(0);
+                discarding = true;
+            }
+            else
+            {
+                frame_buffer.append(data, length);
+            }
+        }
+
+        return length;
+    }
+
+    frame_length = (uint32_t)(frame_end - data);
+
+    if (discarding == true)
+    {
+        discarding = false;
+    }
+    else if (frame_buffer.length() == 0)
+    {
+        //Whole frame is in this read, decode it without copying (empty frames between delimiters are skipped)
+        if (frame_length > 0)
+        {
+            *message_complete = process_frame((const uint8_t *)data, frame_length);
+        }
+    }
+    else
+    {
+        frame_buffer.append(data, frame_length);
+        *message_complete = process_frame((const uint8_t *)frame_buffer.constData(), frame_buffer.length());
+    }
+
+    frame_buffer.resize(0);
+
+    return frame_length + 1;
+}
+
+void smp_uart_framer_cobs::encode(const uint8_t *data, uint16_t length, QByteArray *output)
+{
+    //Frame is a leading delimiter (flushes any noise at the receiver), COBS of the data and CRC, then the trailing delimiter
+    uint16_t crc = smp_uart_crc16(data, length);
+    uint8_t crc_bytes[2] = { (uint8_t)(crc >> 8), (uint8_t)(crc & 0xff) };
+    uint32_t output_pos = 1;
+    uint32_t code_pos;
+    uint8_t code = 1;
+    uint8_t *out;
+
+    //Sized for the worst case, then trimmed, this keeps the existing allocation of the buffer
+    output->resize(encoded_size(length));
+    out = (uint8_t *)output->data();
+    out[0] = smp_uart_cobs_delimiter;
+    code_pos = output_pos;
+    ++output_pos;
+
+    cobs_encode_segment(data, length, out, &output_pos, &code_pos, &code);
+    cobs_encode_segment(crc_bytes, sizeof(crc_bytes), out, &output_pos, &code_pos, &code);
+    out[code_pos] = code;
+    out[output_pos] = smp_uart_cobs_delimiter;
+    ++output_pos;
+
+    output->resize(output_pos);
+}
+
+uint32_t smp_uart_framer_cobs::encoded_size(uint32_t length)
+{
+    //Worst case, data without any zero bytes needs one code byte per 254 bytes
+    uint32_t cobs_input_size = length + 2;
+
+    return cobs_input_size + (cobs_input_size / 254) + 1 + 2;
+}
+
+uint16_t smp_uart_framer_cobs::maximum_message_size(uint32_t encoded_length)
+{
+    uint32_t cobs_input_size;
+
+    if (encoded_length < encoded_size(1))
+    {
+        return 0;
+    }
+
+    //Estimate from the average overhead, then correct for rounding
+    cobs_input_size = ((encoded_length - 3) * 254) / 255;
+
+    while (cobs_input_size > 2 && encoded_size(cobs_input_size - 2) > encoded_length)
+    {
+        --cobs_input_size;
+    }
+
+    while (encoded_size(cobs_input_size - 1) <= encoded_length)
+    {
+        ++cobs_input_size;
+    }
+
+    if (cobs_input_size <= 2)
+    {
+        return 0;
+    }
+
+    return ((cobs_input_size - 2) > UINT16_MAX ? UINT16_MAX : (uint16_t)(cobs_input_size - 2));
+}
+
+QByteArray *smp_uart_framer_cobs::message()
+{
+    return &message_buffer;
+}
+
+bool smp_uart_framer_cobs::process_frame(const uint8_t *frame, uint32_t length)
+{
+    uint32_t input_pos = 0;
+    uint32_t output_pos = 0;
+    uint8_t *out;
+    uint16_t crc;
+    uint16_t message_crc;
+
+    //Decoded data is never larger than the encoded frame
+    message_buffer.resize(length);
+    out = (uint8_t *)message_buffer.data();
+
+    while (input_pos < length)
+    {
+        uint8_t code = frame[input_pos];
+        uint32_t run = (uint32_t)code - 1;
+
+        ++input_pos;
+
+        if (code == 0 || (input_pos + run) > length)
+        {
+            ++error_count;
+            log_error() << "Invalid COBS frame";
+            message_buffer.resize(0);
+            return false;
+        }
+
+        memcpy(&out[output_pos], &frame[input_pos], run);
+        input_pos += run;
+        output_pos += run;
+
+        if (code != cobs_block_code_maximum && input_pos < length)
+        {
+            out[output_pos] = 0;
+            ++output_pos;
+        }
+    }
+
+    if (output_pos <= 2)
+    {
+        ++error_count;
+        log_error() << "Invalid SMP packet length: " << output_pos;
+        message_buffer.resize(0);
+        return false;
+    }
+
+    output_pos -= 2;
+    crc = smp_uart_crc16(out, output_pos);
+    message_crc = ((uint16_t)out[output_pos]) << 8;
+    message_crc |= (uint16_t)out[(output_pos + 1)];
+
+    if (crc != message_crc)
+    {
+        //CRC failure
+        ++error_count;
+        log_error() << "CRC failure, expected " << message_crc << " but got " << crc;
+        message_buffer.resize(0);
+        return false;
+    }
+
+    message_buffer.resize(output_pos);
+
+    return true;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,66 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_framer_cobs.h
+**
+** Notes:   Binary SMP framing for dedicated UARTs: COBS encoded message and
+**          CRC16, delimited by zero bytes
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_FRAMER_COBS_H
+#define SMP_UART_FRAMER_COBS_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_framer.h"
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const uint8_t smp_uart_cobs_delimiter = 0x00;
+
+//Received frames larger than this (encoded) are discarded
+const uint32_t smp_uart_cobs_frame_size_maximum = 65536 + 512;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class smp_uart_framer_cobs : public smp_uart_framer
+{
+public:
+    smp_uart_framer_cobs();
+    void reset() override;
+    uint32_t decode(const char *data, uint32_t length, bool *message_complete) override;
+    void encode(const uint8_t *data, uint16_t length, QByteArray *output) override;
+    uint32_t encoded_size(uint32_t length) override;
+    uint16_t maximum_message_size(uint32_t encoded_length) override;
+    QByteArray *message() override;
+
+private:
+    bool process_frame(const uint8_t *frame, uint32_t length);
+
+    bool discarding;
+    QByteArray frame_buffer;
+    QByteArray message_buffer;
+};
+
+#endif // SMP_UART_FRAMER_COBS_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,380 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_framer_console.cpp
+**
+** Notes:   Streaming encoder/decoder for console-compatible (base64 line) SMP frames
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_framer_console.h"
+#include "smp_uart_crc16.h"
+#include "smp_uart_base64.h"
+#include <debug_logger.h>
+#include <string.h>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+smp_uart_framer_console::smp_uart_framer_console()
+{
+    set_line_size(smp_uart_line_size_default);
+    reset();
+}
+
+void smp_uart_framer_console::reset()
+{
+    state = DECODE_STATE_IDLE;
+    line_is_first = false;
+    waiting_for_continuation = false;
+    waiting_packet_length = 0;
+    line_buffer.resize(0);
+    message_buffer.resize(0);
+}
+
+bool smp_uart_framer_console::set_line_size(uint16_t line_size)
+{
+    if (line_size < smp_uart_line_size_minimum || line_size > smp_uart_line_size_maximum)
+    {
+        return false;
+    }
+
+    //Only whole groups of 4 base64 characters are used, so no padding is needed on full lines
+    line_data_size = ((line_size - sizeof(smp_uart_first_header) - 1) / 4) * 3;
+    line_length_limit = (line_size > smp_uart_receive_line_length_minimum ? line_size : smp_uart_receive_line_length_minimum);
+    line_buffer.reserve(line_length_limit);
+    message_buffer.reserve(line_length_limit);
+    line_data.resize(line_data_size);
+
+    return true;
+}
+
+uint32_t smp_uart_framer_console::decode(const char *data, uint32_t length, bool *message_complete)
+{
+    uint32_t pos = 0;
+
+    *message_complete = false;
+
+    //Every byte is looked at once, state is kept between calls so partial lines are resumed
+    while (pos < length)
+    {
+        switch (state)
+        {
+            case DECODE_STATE_IDLE:
+            {
+                //Skip console output until the first byte of a header is found
+                while (pos < length && (uint8_t)data[pos] != smp_uart_first_header[0] && (uint8_t)data[pos] != smp_uart_continuation_header[0])
+                {
+                    ++pos;
+                }
+
+                if (pos < length)
+                {
+                    state = ((uint8_t)data[pos] == smp_uart_first_header[0] ? DECODE_STATE_FIRST_HEADER : DECODE_STATE_CONTINUATION_HEADER);
+                    ++pos;
+                }
+
+                break;
+            }
+            case DECODE_STATE_FIRST_HEADER:
+            case DECODE_STATE_CONTINUATION_HEADER:
+            {
+                bool is_first = (state == DECODE_STATE_FIRST_HEADER);
+
+                if ((uint8_t)data[pos] != (is_first == true ? smp_uart_first_header[1] : smp_uart_continuation_header[1]))
+                {
+                    //Not a header, re-check this byte as the possible start of one
+                    state = DECODE_STATE_IDLE;
+                    break;
+                }
+
+                ++pos;
+                line_is_first = is_first;
+                line_buffer.resize(0);
+
+                if (is_first == false && waiting_for_continuation == false)
+                {
+                    //Continuation without a preceding start frame, discard it
+                    state = DECODE_STATE_SKIP_LINE;
+                }
+                else
+                {
+                    state = DECODE_STATE_LINE;
+                }
+
+                break;
+            }
+            case DECODE_STATE_LINE:
+            {
+                const char *line_end = (const char *)memchr(&data[pos], smp_uart_line_end, (length - pos));
+                uint32_t line_end_pos = (line_end == nullptr ? length : (uint32_t)(line_end - data));
+                bool complete = false;
+
+                if ((uint32_t)(line_buffer.length() + (line_end_pos - pos)) > line_length_limit)
+                {
+                    ++error_count;
+                    log_error() << "Discarded over-length line in UART SMP transport";
+                    waiting_for_continuation = false;
+                    state = DECODE_STATE_SKIP_LINE;
+                    pos = line_end_pos;
+                    break;
+                }
+
+                if (line_end == nullptr)
+                {
+                    //Partial line, keep it until the rest arrives
+                    line_buffer.append(&data[pos], (line_end_pos - pos));
+                    pos = line_end_pos;
+                    break;
+                }
+
+                if (line_buffer.length() == 0)
+                {
+                    //Whole line is in this read, decode it in place
+                    complete = process_line(&data[pos], (line_end_pos - pos));
+                }
+                else
+                {
+                    line_buffer.append(&data[pos], (line_end_pos - pos));
+                    complete = process_line(line_buffer.constData(), line_buffer.length());
+                }
+
+                pos = line_end_pos + 1;
+                state = DECODE_STATE_IDLE;
+
+                if (complete == true)
+                {
+                    *message_complete = true;
+                    return pos;
+                }
+
+                break;
+            }
+            case DECODE_STATE_SKIP_LINE:
+            {
+                const char *line_end = (const char *)memchr(&data[pos], smp_uart_line_end, (length - pos));
+
+                if (line_end == nullptr)
+                {
+                    pos = length;
+                }
+                else
+                {
+                    pos = (uint32_t)(line_end - data) + 1;
+                    state = DECODE_STATE_IDLE;
+                }
+
+                break;
+            }
+        };
+    }
+
+    return pos;
+}
+
+void smp_uart_framer_console::encode(const uint8_t *data, uint16_t length, QByteArray *output)
+{
+    //Frame is a 2 byte length prefix (which counts the CRC), the data and a 2 byte CRC, split across lines
+    uint8_t *gather = (uint8_t *)line_data.data();
+    uint32_t frame_size = (uint32_t)length + 4;
+    uint16_t crc = smp_uart_crc16(data, length);
+    uint32_t frame_pos = 0;
+    char *out;
+
+    //Resizing keeps the existing allocation of the buffer, so it is only grown for larger messages
+    output->resize(encoded_size(length));
+    out = output->data();
+
+    while (frame_pos < frame_size)
+    {
+        uint32_t line_size = (frame_size - frame_pos) > line_data_size ? line_data_size : (frame_size - frame_pos);
+        const uint8_t *line;
+
+        if (frame_pos == 0)
+        {
+            memcpy(out, smp_uart_first_header, sizeof(smp_uart_first_header));
+        }
+        else
+        {
+            memcpy(out, smp_uart_continuation_header, sizeof(smp_uart_continuation_header));
+        }
+
+        out += sizeof(smp_uart_first_header);
+
+        if (frame_pos >= 2 && (frame_pos + line_size) <= ((uint32_t)length + 2))
+        {
+            //Line only contains message data, encode it in place
+            line = &data[(frame_pos - 2)];
+        }
+        else
+        {
+            //Line contains the length prefix and/or the CRC, gather it first
+            uint32_t i = 0;
+
+            while (i < line_size)
+            {
+                uint32_t index = frame_pos + i;
+
+                if (index < 2)
+                {
+                    gather[i] = (uint8_t)(index == 0 ? ((length + 2) >> 8) : ((length + 2) & 0xff));
+                }
+                else if (index < ((uint32_t)length + 2))
+                {
+                    gather[i] = data[(index - 2)];
+                }
+                else
+                {
+                    gather[i] = (uint8_t)(index == ((uint32_t)length + 2) ? (crc >> 8) : (crc & 0xff));
+                }
+
+                ++i;
+            }
+
+            line = gather;
+        }
+
+        out += smp_uart_base64_encode(line, line_size, out);
+        *out = (char)smp_uart_line_end;
+        ++out;
+        frame_pos += line_size;
+    }
+}
+
+uint32_t smp_uart_framer_console::encoded_size(uint32_t length)
+{
+    uint32_t frame_size = length + 4;
+    uint32_t full_lines = frame_size / line_data_size;
+    uint32_t last_line_size = frame_size % line_data_size;
+    uint32_t size = full_lines * (sizeof(smp_uart_first_header) + smp_uart_base64_encoded_size(line_data_size) + 1);
+
+    if (last_line_size > 0)
+    {
+        size += sizeof(smp_uart_first_header) + smp_uart_base64_encoded_size(last_line_size) + 1;
+    }
+
+    return size;
+}
+
+uint16_t smp_uart_framer_console::maximum_message_size(uint32_t encoded_length)
+{
+    //Inverse of encoded_size(): largest message which, once framed, fits in encoded_length bytes
+    uint32_t full_line_size = sizeof(smp_uart_first_header) + smp_uart_base64_encoded_size(line_data_size) + 1;
+    uint32_t remainder = encoded_length % full_line_size;
+    uint32_t frame_size = (encoded_length / full_line_size) * line_data_size;
+
+    if (remainder > (sizeof(smp_uart_first_header) + 1))
+    {
+        //Partial final line, each group of 4 base64 characters carries 3 bytes
+        frame_size += ((remainder - sizeof(smp_uart_first_header) - 1) / 4) * 3;
+    }
+
+    if (frame_size <= 4)
+    {
+        return 0;
+    }
+
+    frame_size -= 4;
+
+    //The length prefix counts the CRC, so it limits the message to 2 bytes less than its maximum value
+    return (frame_size > (UINT16_MAX - 2) ? (UINT16_MAX - 2) : (uint16_t)frame_size);
+}
+
+QByteArray *smp_uart_framer_console::message()
+{
+    return &message_buffer;
+}
+
+bool smp_uart_framer_console::process_line(const char *line, uint32_t length)
+{
+    uint32_t existing_size = (line_is_first == true ? 0 : message_buffer.length());
+    int32_t decoded_size;
+    uint16_t crc;
+    uint16_t message_crc;
+
+    //Decode straight onto the end of the reassembly buffer
+    message_buffer.resize(existing_size + smp_uart_base64_decoded_size_maximum(length));
+    decoded_size = smp_uart_base64_decode(line, length, ((uint8_t *)message_buffer.data() + existing_size));
+
+    if (decoded_size <= 0)
+    {
+        ++error_count;
+        log_error() << "Failed decoding base64";
+        message_buffer.resize(0);
+        waiting_for_continuation = false;
+        return false;
+    }
+
+    message_buffer.resize(existing_size + decoded_size);
+
+    if (line_is_first == true)
+    {
+        if (decoded_size <= 2)
+        {
+            message_buffer.resize(0);
+            waiting_for_continuation = false;
+            return false;
+        }
+
+        //Length prefix includes the CRC
+        waiting_packet_length = ((uint16_t)(uint8_t)message_buffer[0]) << 8;
+        waiting_packet_length |= (uint16_t)(uint8_t)message_buffer[1];
+        message_buffer.remove(0, 2);
+    }
+
+    if (message_buffer.length() < waiting_packet_length)
+    {
+        //More data expected in another packet
+        waiting_for_continuation = true;
+        return false;
+    }
+
+    waiting_for_continuation = false;
+
+    if (waiting_packet_length < 2)
+    {
+        ++error_count;
+        log_error() << "Invalid SMP packet length: " << waiting_packet_length;
+        return false;
+    }
+
+    //We have a full packet, check the checksum
+    message_buffer.resize(waiting_packet_length);
+    crc = smp_uart_crc16((const uint8_t *)message_buffer.constData(), (waiting_packet_length - 2));
+    message_crc = ((uint16_t)(uint8_t)message_buffer[(waiting_packet_length - 2)]) << 8;
+    message_crc |= (uint16_t)(uint8_t)message_buffer[(waiting_packet_length - 1)];
+
+    if (crc != message_crc)
+    {
+        //CRC failure
+        ++error_count;
+        log_error() << "CRC failure, expected " << message_crc << " but got " << crc;
+        return false;
+    }
+
+    //Good to parse message after removing CRC
+    message_buffer.resize(waiting_packet_length - 2);
+
+    return true;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
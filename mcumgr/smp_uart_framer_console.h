@@ -0,0 +1,87 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_framer_console.h
+**
+** Notes:   Streaming encoder/decoder for console-compatible (base64 line) SMP frames
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_FRAMER_CONSOLE_H
+#define SMP_UART_FRAMER_CONSOLE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_framer.h"
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const uint8_t smp_uart_first_header[] = { 0x06, 0x09 };
+const uint8_t smp_uart_continuation_header[] = { 0x04, 0x14 };
+const uint8_t smp_uart_line_end = 0x0a;
+
+//Line size includes the 2 byte header and the line end, the default of 127 holds base64 of 93 bytes
+const uint16_t smp_uart_line_size_default = 127;
+const uint16_t smp_uart_line_size_minimum = 16;
+const uint16_t smp_uart_line_size_maximum = 8192;
+
+//Received lines are accepted up to at least this size, regardless of the configured send line size
+const uint16_t smp_uart_receive_line_length_minimum = 512;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class smp_uart_framer_console : public smp_uart_framer
+{
+public:
+    smp_uart_framer_console();
+    void reset() override;
+    bool set_line_size(uint16_t line_size);
+    uint32_t decode(const char *data, uint32_t length, bool *message_complete) override;
+    void encode(const uint8_t *data, uint16_t length, QByteArray *output) override;
+    uint32_t encoded_size(uint32_t length) override;
+    uint16_t maximum_message_size(uint32_t encoded_length) override;
+    QByteArray *message() override;
+
+private:
+    enum decode_state_t {
+        DECODE_STATE_IDLE,
+        DECODE_STATE_FIRST_HEADER,
+        DECODE_STATE_CONTINUATION_HEADER,
+        DECODE_STATE_LINE,
+        DECODE_STATE_SKIP_LINE
+    };
+
+    bool process_line(const char *line, uint32_t length);
+
+    enum decode_state_t state;
+    bool line_is_first;
+    bool waiting_for_continuation;
+    uint16_t waiting_packet_length;
+    uint16_t line_length_limit;
+    uint16_t line_data_size;
+    QByteArray line_buffer;
+    QByteArray line_data;
+    QByteArray message_buffer;
+};
+
+#endif // SMP_UART_FRAMER_CONSOLE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
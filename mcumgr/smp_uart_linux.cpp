@@ -0,0 +1,120 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_linux.cpp
+**
+** Notes:   Linux specific serial port configuration for the UART transport
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_linux.h"
+#include <debug_logger.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include <errno.h>
+#include <string.h>
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+bool smp_uart_linux_set_low_latency(int handle)
+{
+    struct serial_struct serial_info;
+    struct termios serial_termios;
+    bool low_latency_set = true;
+
+    //Not all drivers support this (e.g. CDC ACM), in which case the port is used as it is
+    if (ioctl(handle, TIOCGSERIAL, &serial_info) == 0)
+    {
+        if ((serial_info.flags & ASYNC_LOW_LATENCY) == 0)
+        {
+            serial_info.flags |= ASYNC_LOW_LATENCY;
+
+            if (ioctl(handle, TIOCSSERIAL, &serial_info) != 0)
+            {
+                log_error() << "Failed to set serial port low latency mode: " << strerror(errno);
+                low_latency_set = false;
+            }
+        }
+    }
+    else
+    {
+        log_error() << "Serial port driver does not support low latency mode: " << strerror(errno);
+        low_latency_set = false;
+    }
+
+    //No minimum count or inter-byte timer, so the kernel wakes the reader for every received byte
+    if (ioctl(handle, TCGETS, &serial_termios) == 0)
+    {
+        if (serial_termios.c_cc[VMIN] != 0 || serial_termios.c_cc[VTIME] != 0)
+        {
+            serial_termios.c_cc[VMIN] = 0;
+            serial_termios.c_cc[VTIME] = 0;
+
+            if (ioctl(handle, TCSETS, &serial_termios) != 0)
+            {
+                log_error() << "Failed to set serial port read timeouts: " << strerror(errno);
+            }
+        }
+    }
+
+    return low_latency_set;
+}
+
+bool smp_uart_linux_set_baud_rate(int handle, uint32_t baud, uint32_t *actual_baud)
+{
+    struct termios2 serial_termios;
+
+    *actual_baud = 0;
+
+    if (ioctl(handle, TCGETS2, &serial_termios) != 0)
+    {
+        log_error() << "Failed to get serial port settings: " << strerror(errno);
+        return false;
+    }
+
+    //BOTHER takes the rate as a number rather than one of the fixed Bxxx values, for both directions
+    serial_termios.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    serial_termios.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    serial_termios.c_ospeed = baud;
+    serial_termios.c_ispeed = baud;
+
+    if (ioctl(handle, TCSETS2, &serial_termios) != 0)
+    {
+        log_error() << "Failed to set serial port baud rate " << baud << ": " << strerror(errno);
+        return false;
+    }
+
+    //The driver may round to the nearest rate its clock divider can produce
+    if (ioctl(handle, TCGETS2, &serial_termios) != 0)
+    {
+        log_error() << "Failed to read back serial port baud rate: " << strerror(errno);
+        return false;
+    }
+
+    *actual_baud = serial_termios.c_ospeed;
+
+    return true;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,44 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_linux.h
+**
+** Notes:   Linux specific serial port configuration for the UART transport
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_LINUX_H
+#define SMP_UART_LINUX_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+//Sets ASYNC_LOW_LATENCY on the serial driver (FTDI adapters also drop their latency timer to 1ms) and makes reads return as soon as data is available
+bool smp_uart_linux_set_low_latency(int handle);
+
+//Sets any baud rate the driver supports using termios2 with BOTHER, actual_baud is read back from the driver afterwards
+bool smp_uart_linux_set_baud_rate(int handle, uint32_t baud, uint32_t *actual_baud);
+
+#endif // SMP_UART_LINUX_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,123 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_message_queue.h
+**
+** Notes:   Lock-free single producer, single consumer queue of received SMP
+**          messages, used to pass messages from the UART I/O thread
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_MESSAGE_QUEUE_H
+#define SMP_UART_MESSAGE_QUEUE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <atomic>
+#include <stdint.h>
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class smp_uart_message_queue
+{
+public:
+    smp_uart_message_queue()
+    {
+        head.store(0);
+        tail.store(0);
+        notify_pending.store(false);
+        clock.start();
+    }
+
+    //Producer: returns the next free entry to fill, or nullptr if the queue is full
+    QByteArray *push_entry()
+    {
+        uint32_t current_head = head.load(std::memory_order_relaxed);
+
+        if ((current_head - tail.load(std::memory_order_acquire)) >= queue_size)
+        {
+            return nullptr;
+        }
+
+        return &entries[(current_head % queue_size)];
+    }
+
+    //Producer: publishes the entry returned by push_entry(), returns true if the consumer needs to be notified
+    bool push_commit()
+    {
+        uint32_t current_head = head.load(std::memory_order_relaxed);
+
+        timestamps[(current_head % queue_size)] = clock.nsecsElapsed();
+        head.store((current_head + 1), std::memory_order_release);
+
+        return (notify_pending.exchange(true, std::memory_order_acq_rel) == false);
+    }
+
+    //Consumer: must be called before draining the queue so that later pushes notify again. This is a read-modify-write rather than a
+    //store so that it is ordered with the producer's exchange, a producer whose exchange comes first then has its head visible to the drain
+    void clear_notify()
+    {
+        notify_pending.exchange(false, std::memory_order_acq_rel);
+    }
+
+    //Consumer: returns the oldest entry and the time it has been queued for in ns, or nullptr if the queue is empty
+    QByteArray *front(qint64 *queued_ns)
+    {
+        uint32_t current_tail = tail.load(std::memory_order_relaxed);
+
+        if (current_tail == head.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        *queued_ns = clock.nsecsElapsed() - timestamps[(current_tail % queue_size)];
+
+        return &entries[(current_tail % queue_size)];
+    }
+
+    //Consumer: releases the entry returned by front(), it must not be referenced afterwards
+    void pop()
+    {
+        tail.store((tail.load(std::memory_order_relaxed) + 1), std::memory_order_release);
+    }
+
+    //Either side: monotonic time in ns shared by both threads
+    qint64 now_ns() const
+    {
+        return clock.nsecsElapsed();
+    }
+
+private:
+    static const uint32_t queue_size = 16;
+
+    //Entries keep their allocation between uses, they are only written by whichever side owns them
+    QByteArray entries[queue_size];
+    qint64 timestamps[queue_size];
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    alignas(64) std::atomic<bool> notify_pending;
+    QElapsedTimer clock;
+};
+
+#endif // SMP_UART_MESSAGE_QUEUE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,514 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_worker.cpp
+**
+** Notes:   Owns the serial port and frame decoder of the UART transport, can
+**          be run on the caller's thread or on a dedicated I/O thread
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "smp_uart_worker.h"
+#include "smp_uart.h"
+#include <string.h>
+
+#if defined(Q_OS_LINUX)
+#include "smp_uart_linux.h"
+#endif
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+static const uint16_t receive_buffer_size = 4096;
+static const uint8_t latency_probe_interval_ms = 5;
+static const uint32_t line_gap_maximum_us = 100000;
+static const uint32_t line_gap_step_us = 1000;
+static const uint8_t line_gap_decrease_interval = 8;
+static const uint8_t line_gap_backoffs_per_request_maximum = 2;
+static const qint64 pacing_write_ahead_minimum_ns = 2000000;
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+smp_uart_worker::smp_uart_worker(smp_uart_message_queue *queue) : serial_port(this), latency_timer(this), pacing_timer(this)
+{
+    message_queue = queue;
+    framer = nullptr;
+    actual_baud = 0;
+    port_open.store(false);
+    write_depth.store(0);
+    write_queue_offset = 0;
+    write_depth_maximum = 0;
+    pacing_allowed = false;
+    paced = false;
+    request_backoffs = 0;
+    receive_buffer.resize(receive_buffer_size);
+    pacing_timer.setTimerType(Qt::PreciseTimer);
+    pacing_timer.setSingleShot(true);
+    latency_timer.setTimerType(Qt::PreciseTimer);
+    latency_timer.setInterval(latency_probe_interval_ms);
+    memset(&latency, 0, sizeof(latency));
+
+    QObject::connect(&serial_port, SIGNAL(readyRead()), this, SLOT(serial_read()));
+    QObject::connect(&serial_port, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(serial_error(QSerialPort::SerialPortError)));
+    QObject::connect(&latency_timer, SIGNAL(timeout()), this, SLOT(latency_probe()));
+    QObject::connect(&pacing_timer, SIGNAL(timeout()), this, SLOT(pace_write()));
+    QObject::connect(&serial_port, SIGNAL(bytesWritten(qint64)), this, SLOT(serial_bytes_written(qint64)));
+}
+
+smp_uart_worker::~smp_uart_worker()
+{
+    QObject::disconnect(&serial_port, SIGNAL(readyRead()), this, SLOT(serial_read()));
+    QObject::disconnect(&serial_port, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(serial_error(QSerialPort::SerialPortError)));
+    QObject::disconnect(&latency_timer, SIGNAL(timeout()), this, SLOT(latency_probe()));
+    QObject::disconnect(&pacing_timer, SIGNAL(timeout()), this, SLOT(pace_write()));
+    QObject::disconnect(&serial_port, SIGNAL(bytesWritten(qint64)), this, SLOT(serial_bytes_written(qint64)));
+
+    close();
+
+    if (framer != nullptr)
+    {
+        delete framer;
+    }
+}
+
+int smp_uart_worker::open(struct smp_uart_config_t *configuration)
+{
+    smp_uart_framer *new_framer = smp_uart_framer_create(configuration->framing, configuration->line_size);
+
+    if (new_framer == nullptr)
+    {
+        return SMP_TRANSPORT_ERROR_INVALID_CONFIGURATION;
+    }
+
+    if (framer != nullptr)
+    {
+        delete framer;
+    }
+
+    framer = new_framer;
+
+    serial_port.setPortName(configuration->port_name);
+#if defined(Q_OS_LINUX)
+    //Opened at a standard rate, the requested rate is then set through termios2 which also supports non-standard rates
+    serial_port.setBaudRate(QSerialPort::Baud115200);
+#else
+    serial_port.setBaudRate(configuration->baud);
+#endif
+    serial_port.setDataBits(configuration->data_bits == SMP_UART_DATA_BITS_8 ? QSerialPort::Data8 : QSerialPort::Data7);
+    serial_port.setStopBits((configuration->stop_bits == SMP_UART_STOP_BITS_1 ? QSerialPort::OneStop : (configuration->stop_bits == SMP_UART_STOP_BITS_1_AND_HALF ? QSerialPort::OneAndHalfStop : QSerialPort::TwoStop)));
+    serial_port.setParity((configuration->parity == SMP_UART_PARITY_NONE ? QSerialPort::NoParity : (configuration->parity == SMP_UART_PARITY_EVEN ? QSerialPort::EvenParity : (configuration->parity == SMP_UART_PARITY_ODD ? QSerialPort::OddParity : (configuration->parity == SMP_UART_PARITY_SPACE ? QSerialPort::SpaceParity : QSerialPort::MarkParity)))));
+    serial_port.setFlowControl((configuration->flow_control == SMP_UART_FLOW_CONTROL_NONE ? QSerialPort::NoFlowControl : (configuration->flow_control == SMP_UART_FLOW_CONTROL_HARDWARE ? QSerialPort::HardwareControl : QSerialPort::SoftwareControl)));
+
+    if (serial_port.open(QIODevice::ReadWrite) == false)
+    {
+        return SMP_TRANSPORT_ERROR_OPEN_FAILED;
+    }
+
+#if defined(Q_OS_LINUX)
+    if (smp_uart_linux_set_baud_rate(serial_port.handle(), configuration->baud, &actual_baud) == false)
+    {
+        serial_port.close();
+        return SMP_TRANSPORT_ERROR_OPEN_FAILED;
+    }
+#else
+    actual_baud = serial_port.baudRate();
+#endif
+
+    if (actual_baud != configuration->baud)
+    {
+        log_error() << "UART baud rate " << configuration->baud << " is not supported exactly, driver is using " << actual_baud;
+    }
+    else
+    {
+        log_information() << "UART baud rate: " << actual_baud;
+    }
+
+    //Successful, set RTS to be asserted if hardware flow control is not used
+    if (configuration->flow_control != SMP_UART_FLOW_CONTROL_HARDWARE)
+    {
+        serial_port.setRequestToSend(true);
+    }
+
+    if (configuration->low_latency == true)
+    {
+#if defined(Q_OS_LINUX)
+        smp_uart_linux_set_low_latency(serial_port.handle());
+#else
+        log_information() << "Serial port low latency mode is not supported on this platform";
+#endif
+    }
+
+    //Without flow control nothing stops lines overrunning the device, so writes can be paced from the expected time on the wire.
+    //Frames are written in one go until a line gap is needed, either because one was configured or because lines were lost
+    pacing_allowed = (configuration->flow_control == SMP_UART_FLOW_CONTROL_NONE);
+    paced = (pacing_allowed == true && configuration->line_gap > 0);
+    split_at_line_end = (configuration->framing == SMP_UART_FRAMING_CONSOLE);
+    chunk_size_maximum = configuration->line_size;
+    bits_per_character = 1 + (configuration->data_bits == SMP_UART_DATA_BITS_8 ? 8 : 7) + (configuration->parity == SMP_UART_PARITY_NONE ? 0 : 1) + (configuration->stop_bits == SMP_UART_STOP_BITS_1 ? 1 : 2);
+    line_gap_minimum_us = (uint32_t)configuration->line_gap * 1000;
+    line_gap_us = line_gap_minimum_us;
+    wire_free_ns = 0;
+    next_write_ns = 0;
+    request_backoffs = 0;
+    framer_errors = 0;
+    consecutive_successes = 0;
+    write_depth_maximum = 0;
+
+    if (actual_baud == 0)
+    {
+        actual_baud = configuration->baud;
+    }
+
+    port_open.store(true);
+
+    memset(&latency, 0, sizeof(latency));
+
+    if (configuration->latency_statistics == true)
+    {
+        latency_expected_ns = message_queue->now_ns() + ((qint64)latency_probe_interval_ms * 1000000);
+        latency_timer.start();
+    }
+
+    return SMP_TRANSPORT_ERROR_OK;
+}
+
+void smp_uart_worker::close()
+{
+    latency_timer.stop();
+    pacing_timer.stop();
+    port_open.store(false);
+    write_queue.resize(0);
+    write_queue_offset = 0;
+    write_depth.store(0);
+
+    if (serial_port.isOpen() == true)
+    {
+        serial_port.close();
+    }
+
+    if (framer != nullptr)
+    {
+        framer->reset();
+    }
+}
+
+bool smp_uart_worker::is_open()
+{
+    return port_open.load();
+}
+
+void smp_uart_worker::write(const QByteArray &data)
+{
+    write_queue.append(data);
+
+    if (pacing_timer.isActive() == false)
+    {
+        pace_write();
+    }
+    else
+    {
+        update_write_queue_depth();
+    }
+}
+
+uint32_t smp_uart_worker::write_queue_depth()
+{
+    return write_depth.load();
+}
+
+void smp_uart_worker::pacing_statistics(uint32_t *maximum_write_queue_depth, uint32_t *current_line_gap_us)
+{
+    *maximum_write_queue_depth = write_depth_maximum;
+    *current_line_gap_us = (paced == true ? line_gap_us : 0);
+}
+
+uint32_t smp_uart_worker::baud_rate()
+{
+    return actual_baud;
+}
+
+void smp_uart_worker::event_loop_latency(struct smp_uart_latency_t *latency_output)
+{
+    *latency_output = latency;
+}
+
+void smp_uart_worker::serial_read()
+{
+    while (serial_port.bytesAvailable() > 0)
+    {
+        qint64 read_size = serial_port.read(receive_buffer.data(), receive_buffer.size());
+        const char *data = receive_buffer.constData();
+        uint32_t remaining;
+
+        if (read_size <= 0)
+        {
+            break;
+        }
+
+        remaining = (uint32_t)read_size;
+
+        //Feed the received data through the frame decoder, which keeps state between reads
+        while (remaining > 0)
+        {
+            bool message_complete;
+            uint32_t used = framer->decode(data, remaining, &message_complete);
+
+            data += used;
+            remaining -= used;
+
+            if (message_complete == true)
+            {
+                request_backoffs = 0;
+                pacing_success();
+
+                QByteArray *entry = message_queue->push_entry();
+                QByteArray *message = framer->message();
+
+                if (entry == nullptr)
+                {
+                    log_error() << "UART SMP receive queue full, discarding message";
+                    continue;
+                }
+
+                //Copied rather than shared so the decoder and the queue entry both keep their allocations
+                entry->resize(message->length());
+                memcpy(entry->data(), message->constData(), message->length());
+
+                if (message_queue->push_commit() == true)
+                {
+                    emit messages_waiting();
+                }
+            }
+        }
+    }
+
+    if (framer->errors() != framer_errors)
+    {
+        //Corrupt responses usually mean the device (or adapter) is being overrun as well
+        framer_errors = framer->errors();
+        pacing_failure();
+    }
+}
+
+void smp_uart_worker::pace_write()
+{
+    while (write_queue_offset < (uint32_t)write_queue.length())
+    {
+        const char *data = write_queue.constData() + write_queue_offset;
+        uint32_t remaining = (uint32_t)write_queue.length() - write_queue_offset;
+        uint32_t chunk_size;
+        qint64 now;
+        qint64 wire_start;
+
+        if (paced == false)
+        {
+            //Flow control is done by the driver, hand everything over in one write
+            serial_port.write(data, remaining);
+            write_queue_offset += remaining;
+            break;
+        }
+
+        now = message_queue->now_ns();
+
+        if (now < next_write_ns)
+        {
+            pacing_timer.start((int)((next_write_ns - now + 999999) / 1000000));
+            break;
+        }
+
+        //One line (or chunk of the line size for binary framing) at a time
+        chunk_size = (remaining > chunk_size_maximum ? chunk_size_maximum : remaining);
+
+        if (split_at_line_end == true)
+        {
+            const char *line_end = (const char *)memchr(data, smp_uart_line_end, chunk_size);
+
+            if (line_end != nullptr)
+            {
+                chunk_size = (uint32_t)(line_end - data) + 1;
+            }
+        }
+
+        serial_port.write(data, chunk_size);
+        write_queue_offset += chunk_size;
+
+        //Estimate when the chunk will have left the UART, the gap is timed from then
+        wire_start = (wire_free_ns > now ? wire_free_ns : now);
+        wire_free_ns = wire_start + (((qint64)chunk_size * bits_per_character * 1000000000) / actual_baud);
+
+        if (line_gap_us > 0)
+        {
+            next_write_ns = wire_free_ns + ((qint64)line_gap_us * 1000);
+        }
+        else
+        {
+            //No gap, keep enough queued that the UART does not go idle between (millisecond resolution) timer wake-ups
+            qint64 write_ahead_ns = (((qint64)chunk_size_maximum * bits_per_character * 1000000000) / actual_baud);
+
+            if (write_ahead_ns < pacing_write_ahead_minimum_ns)
+            {
+                write_ahead_ns = pacing_write_ahead_minimum_ns;
+            }
+
+            next_write_ns = wire_free_ns - write_ahead_ns;
+        }
+    }
+
+    if (write_queue_offset >= (uint32_t)write_queue.length())
+    {
+        //Keeps the allocation for the next frame
+        write_queue.resize(0);
+        write_queue_offset = 0;
+    }
+
+    update_write_queue_depth();
+}
+
+void smp_uart_worker::serial_bytes_written(qint64 bytes)
+{
+    Q_UNUSED(bytes);
+
+    update_write_queue_depth();
+}
+
+void smp_uart_worker::update_write_queue_depth()
+{
+    uint32_t depth = ((uint32_t)write_queue.length() - write_queue_offset) + (uint32_t)serial_port.bytesToWrite();
+
+    if (depth > write_depth_maximum)
+    {
+        write_depth_maximum = depth;
+    }
+
+    write_depth.store(depth);
+}
+
+void smp_uart_worker::request_retransmitted()
+{
+    //The previous attempt went unanswered, which may be because its lines overran the device
+    pacing_failure();
+}
+
+void smp_uart_worker::request_abandoned()
+{
+    //The next request starts afresh, a request which was given up on must not affect it
+    request_backoffs = 0;
+}
+
+void smp_uart_worker::pacing_failure()
+{
+    uint32_t new_gap = line_gap_us * 2;
+
+    consecutive_successes = 0;
+
+    //A single request (a device which is busy or has gone away) can only back the gap off a limited number of times
+    if (pacing_allowed == false || request_backoffs >= line_gap_backoffs_per_request_maximum)
+    {
+        return;
+    }
+
+    ++request_backoffs;
+
+    if (paced == false)
+    {
+        paced = true;
+        log_debug() << "UART write pacing enabled";
+    }
+
+    //Gap backs off multiplicatively on loss and recovers additively, bounded by the configured gap
+    if (new_gap < (line_gap_us + line_gap_step_us))
+    {
+        new_gap = line_gap_us + line_gap_step_us;
+    }
+
+    if (new_gap > line_gap_maximum_us)
+    {
+        new_gap = line_gap_maximum_us;
+    }
+
+    if (new_gap != line_gap_us)
+    {
+        line_gap_us = new_gap;
+        log_debug() << "UART line gap increased to " << line_gap_us << "us";
+    }
+}
+
+void smp_uart_worker::pacing_success()
+{
+    if (paced == false || line_gap_us <= line_gap_minimum_us)
+    {
+        return;
+    }
+
+    ++consecutive_successes;
+
+    if (consecutive_successes >= line_gap_decrease_interval)
+    {
+        consecutive_successes = 0;
+        line_gap_us = ((line_gap_us - line_gap_minimum_us) > line_gap_step_us ? (line_gap_us - line_gap_step_us) : line_gap_minimum_us);
+        log_debug() << "UART line gap decreased to " << line_gap_us << "us";
+
+        if (line_gap_us == 0)
+        {
+            //Back to the configured gap of 0, so frames are written in one go again
+            paced = false;
+            log_debug() << "UART write pacing disabled";
+        }
+    }
+}
+
+void smp_uart_worker::serial_error(QSerialPort::SerialPortError error_code)
+{
+    if (error_code == QSerialPort::NoError)
+    {
+        return;
+    }
+
+    log_error() << "Serial port error: " << error_code;
+    close();
+    emit error(error_code);
+}
+
+void smp_uart_worker::latency_probe()
+{
+    //Measures how late the timer fires, which is how long received serial data could have waited in this thread
+    qint64 now = message_queue->now_ns();
+    qint64 late = now - latency_expected_ns;
+
+    if (late < 0)
+    {
+        late = 0;
+    }
+
+    ++latency.samples;
+    latency.total_ns += late;
+
+    if (late > latency.maximum_ns)
+    {
+        latency.maximum_ns = late;
+    }
+
+    latency_expected_ns = now + ((qint64)latency_probe_interval_ms * 1000000);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
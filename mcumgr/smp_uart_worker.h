@@ -0,0 +1,123 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  smp_uart_worker.h
+**
+** Notes:   Owns the serial port and frame decoder of the UART transport, can
+**          be run on the caller's thread or on a dedicated I/O thread
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SMP_UART_WORKER_H
+#define SMP_UART_WORKER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QSerialPort>
+#include <QTimer>
+#include <atomic>
+#include "smp_uart_framer.h"
+#include "smp_uart_message_queue.h"
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+struct smp_uart_config_t;
+
+struct smp_uart_latency_t {
+    uint32_t samples;
+    qint64 total_ns;
+    qint64 maximum_ns;
+};
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class smp_uart_worker : public QObject
+{
+    Q_OBJECT
+
+public:
+    smp_uart_worker(smp_uart_message_queue *queue);
+    ~smp_uart_worker();
+
+    //These must only be called from the thread the worker lives in, except for is_open()
+    int open(struct smp_uart_config_t *configuration);
+    void close();
+    bool is_open();
+    void write(const QByteArray &data);
+    uint32_t write_queue_depth();
+    uint32_t baud_rate();
+    void event_loop_latency(struct smp_uart_latency_t *latency);
+    void pacing_statistics(uint32_t *maximum_write_queue_depth, uint32_t *line_gap_us);
+
+    //The transport decides what is a retransmission, a request which is given up on without a response must be reported as abandoned
+    void request_retransmitted();
+    void request_abandoned();
+
+signals:
+    void messages_waiting();
+    void error(int error);
+
+private slots:
+    void serial_read();
+    void serial_error(QSerialPort::SerialPortError error);
+    void latency_probe();
+    void pace_write();
+    void serial_bytes_written(qint64 bytes);
+
+private:
+    void pacing_failure();
+    void pacing_success();
+    void update_write_queue_depth();
+
+    QSerialPort serial_port;
+    QTimer latency_timer;
+    QTimer pacing_timer;
+    QByteArray receive_buffer;
+    smp_uart_framer *framer;
+    smp_uart_message_queue *message_queue;
+    std::atomic<bool> port_open;
+    std::atomic<uint32_t> write_depth;
+    uint32_t actual_baud;
+
+    //Write pacing, only used when there is no flow control and a line gap is configured or lines have been lost
+    QByteArray write_queue;
+    uint32_t write_queue_offset;
+    uint32_t write_depth_maximum;
+    bool pacing_allowed;
+    bool paced;
+    bool split_at_line_end;
+    uint16_t chunk_size_maximum;
+    uint8_t bits_per_character;
+    uint32_t line_gap_minimum_us;
+    uint32_t line_gap_us;
+    qint64 wire_free_ns;
+    qint64 next_write_ns;
+    uint8_t request_backoffs;
+    uint32_t framer_errors;
+    uint8_t consecutive_successes;
+    qint64 latency_expected_ns;
+    struct smp_uart_latency_t latency;
+};
+
+#endif // SMP_UART_WORKER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
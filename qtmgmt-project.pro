@@ -7,3 +7,8 @@ SUBDIRS += \
     mcumgr
 
 qtmgmt.depends += mcumgr
+
+qtHaveModule(testlib) {
+    # Requires qttestlib, run with make check
+    SUBDIRS += tests
+}
@@ -25,16 +25,26 @@
 // Include Files
 /******************************************************************************/
 #include "command_processor.h"
+#include "sha256.h"
 #include <QDebug>
+#include <QSettings>
+#include <QFileInfo>
+#include <QDateTime>
 #include <AuTerm/AuTerm/AutEscape.h>
 
 //UART
 const QCommandLineOption option_transport_uart_port("port", "UART port", "port");
-const QCommandLineOption option_transport_uart_baud("baud", "UART baud rate (default: 115200)", "port");
+const QCommandLineOption option_transport_uart_baud("baud", "UART baud rate, non-standard rates are supported on Linux (default: 115200)", "baud");
 const QCommandLineOption option_transport_uart_flow_control("flow-control", "UART flow control (default: none, can be: none, hardware, software)", "flow-control");
 const QCommandLineOption option_transport_uart_parity("parity", "UART parity (default: none, can be: none, even, odd, space, mark)", "parity");
 const QCommandLineOption option_transport_uart_data_bits("data-bits", "UART data bits (default: 8, can be: 7, 8)", "data-bits");
 const QCommandLineOption option_transport_uart_stop_bits("stop-bits", "UART stop bits (default: 1, can be: 1, 1.5, 2)", "stop-bits");
+const QCommandLineOption option_transport_uart_framing("uart-framing", "UART SMP framing, cobs requires matching device support (default: console, can be: console, cobs)", "framing");
+const QCommandLineOption option_transport_uart_line_gap("uart-line-gap", "Minimum gap between UART lines in ms when flow control is not used, increased automatically when lines are lost (default: 0, range: 0-100)", "ms");
+const QCommandLineOption option_transport_uart_io_thread("uart-io-thread", "Run the UART serial port and frame decoder on a dedicated thread");
+const QCommandLineOption option_transport_uart_latency_statistics("uart-latency-stats", "Log UART event loop latency, message dispatch latency and SMP round trip times when the port is closed");
+const QCommandLineOption option_transport_uart_low_latency("low-latency", "Put the serial driver in low latency mode, reduces USB to UART adapter delays (Linux only)");
+const QCommandLineOption option_transport_uart_line_size("uart-line-size", "UART SMP line size including header and line end, must match the receive line buffer of the device (default: 127, range: 16-8192)", "size");
 
 //Bluetooth
 const QCommandLineOption option_transport_bluetooth_name("name", "Bluetooth device name", "name");
@@ -76,10 +86,15 @@ const QCommandLineOption option_command_img_hash("hash", "Hash of image", "hash"
 const QCommandLineOption option_command_img_test("test", "Mark image as test");
 const QCommandLineOption option_command_img_confirm("confirm", "Mark image as confirmed");
 const QCommandLineOption option_command_img_reset("reset", "Reset after update");
-const QCommandLineOption option_command_img_image("image", "Image number", "image");
-const QCommandLineOption option_command_img_file("file", "Firmware update", "file");
+const QCommandLineOption option_command_img_image("image", "Image number, for multi-image updates give one for each --file", "image");
+const QCommandLineOption option_command_img_file("file", "Firmware update, can be repeated for multi-image updates", "file");
 const QCommandLineOption option_command_img_upgrade("upgrade", "Only accept upgrades");
 const QCommandLineOption option_command_img_slot("slot", "Slot number", "slot");
+const QCommandLineOption option_command_img_resume("resume", "Resume an interrupted upload, fails if none of the given files was being uploaded to this transport");
+const QCommandLineOption option_command_img_verify("verify", "After --reset, wait for the device to return and check that it runs the new image");
+const QCommandLineOption option_command_img_verify_confirm("verify-confirm", "Confirm the image once --verify has seen it running");
+const QCommandLineOption option_command_img_verify_timeout("verify-timeout", "Seconds to wait for the device to return after the reset (default: 60, can be: 1-3600)", "verify-timeout");
+const QCommandLineOption option_command_img_skip_if_present("skip-if-present", "Skip the upload if the image is already in a slot of the device");
 
 //Shell management group
 const QCommandLineOption option_command_shell_run("run", "Command to execute", "command");
@@ -88,9 +103,10 @@ const QCommandLineOption option_command_shell_run("run", "Command to execute", "
 const QCommandLineOption option_command_stats_group("group", "Group to get statistics of", "group");
 
 //SMP options
-const QCommandLineOption option_mtu("mtu", "MTU (default: 256, can be: 96-16384)", "mtu");
+const QCommandLineOption option_mtu("mtu", "MTU (default: 256, can be: 96-16384 or auto to query the device)", "mtu");
 const QCommandLineOption option_smp_v1("smp-v1", "Use SMP version 1");
 const QCommandLineOption option_smp_v2("smp-v2", "Use SMP version 2 (default)");
+const QCommandLineOption option_adaptive_timeout("adaptive-timeout", "Derive command timeouts from measured round trip times (UART transport only)");
 
 const QString indent = "    ";
 #ifdef WIN32
@@ -121,6 +137,12 @@ command_processor::command_processor(QObject *parent) : QObject{parent}
     mode = ACTION_IDLE;
     smp_v2 = true;
     smp_mtu = 256;
+    smp_mtu_auto = false;
+    smp_version_set = false;
+    adaptive_timeout = false;
+    timeout_group = nullptr;
+    timeout_floor_ms = 0;
+    timeout_retries = 0;
     enum_mgmt_group_ids = nullptr;
     enum_mgmt_group_details = nullptr;
     fs_mgmt_hash_checksum = nullptr;
@@ -134,6 +156,30 @@ command_processor::command_processor(QObject *parent) : QObject{parent}
     stat_mgmt_stats = nullptr;
     stat_mgmt_groups = nullptr;
     is_interactive_mode = false;
+    upload_image = 0;
+    upload_progress = 0;
+    upload_upgrade = false;
+    upload_resume = false;
+    upload_skip_if_present = false;
+    upload_index = 0;
+    upload_mark_index = 0;
+    upload_verify = false;
+    upload_verify_confirm = false;
+    upload_verify_timeout_ms = 0;
+    upload_verify_delay_ms = 0;
+    upload_verify_connecting = false;
+    command_exit_code = EXIT_CODE_SUCCESS;
+
+    upload_verify_timer.setSingleShot(true);
+    connect(&upload_verify_timer, SIGNAL(timeout()), this, SLOT(upload_verify_poll()));
+
+    //Interruptions are handled on the event loop so that upload state can be saved and the transport closed
+    connect(&termination_handler, SIGNAL(terminate_requested(int)), this, SLOT(terminate_requested(int)));
+
+    if (termination_handler.install() == false)
+    {
+        log_error() << "Failed to install signal handler";
+    }
 
     //Execute run function in event loop so that QCoreApplication::exit() works
     QTimer::singleShot(0, this, SLOT(run()));
@@ -329,6 +375,7 @@ void command_processor::run(QStringList args)
     uint16_t active_transport_index = 0;
     uint16_t active_group_index = 0;
     uint16_t active_command_index = 0;
+    bool local_command = false;
 
     parser.setSingleDashWordOptionMode(QCommandLineParser::ParseAsLongOptions);
     parser.addOption(option_help);
@@ -534,6 +581,7 @@ void command_processor::run(QStringList args)
 
     //Add SMP version command line
     entries.append({{&option_smp_v1, &option_smp_v2}, false, true});
+    entries.append({{&option_adaptive_timeout}, false, false});
 
     if (parser.isSet(option_transport))
     {
@@ -541,6 +589,7 @@ void command_processor::run(QStringList args)
         l = supported_transports.length();
 
         user_transport = parser.value(option_transport);
+        session_transport = user_transport;
 
         while (i < l)
         {
@@ -589,6 +638,7 @@ void command_processor::run(QStringList args)
                             }
 
                             active_command_index = i2;
+                            local_command = supported_groups[i].commands[i2].local;
                             break;
                         }
 
@@ -645,9 +695,9 @@ void command_processor::run(QStringList args)
         return interactive_mode();
     }
 
-    if (!parser.isSet(option_transport) || !parser.isSet(option_group) || !parser.isSet(option_command))
+    if ((!parser.isSet(option_transport) && local_command == false) || !parser.isSet(option_group) || !parser.isSet(option_command))
     {
-        if (!parser.isSet(option_transport))
+        if (!parser.isSet(option_transport) && local_command == false)
         {
             fputs(qPrintable(tr("Missing required argument: ") % "--" % option_transport.names().join(" or --") % newline), stdout);
         }
@@ -758,29 +808,50 @@ void command_processor::run(QStringList args)
         return return_status(EXIT_CODE_MISSING_REQUIRED_ARGUMENTS);
     }
 
+    if (local_command == true)
+    {
+        //Runs to completion without a transport or group, so the result is the final exit code
+        return return_status((this->*supported_groups[active_group_index].commands[active_command_index].run_function)(&parser));
+    }
+
 //TODO: Check that options supplied for each transport/group are valid
 
     //Apply SMP parameters
+    smp_mtu_auto = false;
+    smp_version_set = false;
+
     if (parser.isSet(option_mtu) == true)
     {
-        smp_mtu = parser.value(option_mtu).toUInt();
-
-        if (smp_mtu < minimum_smp_mtu || smp_mtu > maximum_smp_mtu)
+        if (parser.value(option_mtu) == "auto")
+        {
+            smp_mtu_auto = true;
+        }
+        else
         {
-            fputs(qPrintable(tr("Argument out of range: ") % "--" % option_mtu.names().first() % newline), stdout);
-            return return_status(EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE);
+            smp_mtu = parser.value(option_mtu).toUInt();
+
+            if (smp_mtu < minimum_smp_mtu || smp_mtu > maximum_smp_mtu)
+            {
+                fputs(qPrintable(tr("Argument out of range: ") % "--" % option_mtu.names().first() % newline), stdout);
+                return return_status(EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE);
+            }
         }
     }
 
     if (parser.isSet(option_smp_v1) == true)
     {
         smp_v2 = false;
+        smp_version_set = true;
     }
     else if (parser.isSet(option_smp_v2) == true)
     {
         smp_v2 = true;
+        smp_version_set = true;
     }
 
+    adaptive_timeout = parser.isSet(option_adaptive_timeout);
+    round_trip_estimator.reset();
+
     //Set up and open transport
     if (0)
     {
@@ -790,6 +861,8 @@ void command_processor::run(QStringList args)
     {
         transport_uart = new smp_uart(this);
         active_transport = transport_uart;
+        connect(transport_uart, SIGNAL(round_trip_sample(uint32_t)), this, SLOT(transport_round_trip_sample(uint32_t)));
+        connect(transport_uart, SIGNAL(request_retry()), this, SLOT(transport_request_retry()));
     }
 #endif
 #if defined(PLUGIN_MCUMGR_TRANSPORT_BLUETOOTH)
@@ -842,6 +915,19 @@ void command_processor::run(QStringList args)
 
     disconnect(active_transport, SIGNAL(connected()), &wait_loop, SLOT(quit()));
 
+#if defined(PLUGIN_MCUMGR_TRANSPORT_UART)
+    if (active_transport == transport_uart)
+    {
+        bool exact_baud;
+        uint32_t actual_baud = transport_uart->baud_rate(&exact_baud);
+
+        if (exact_baud == false)
+        {
+            fputs(qPrintable(tr("Warning: requested baud rate is not supported exactly, using: ") % QString::number(actual_baud) % newline), stdout);
+        }
+    }
+#endif
+
     //Issue specified command
     processor = new smp_processor(this);
     connect(active_transport, SIGNAL(receive_waiting(smp_message*)), processor, SLOT(message_received(smp_message*)));
@@ -908,6 +994,11 @@ void command_processor::run(QStringList args)
 
     processor->set_transport(active_transport);
 
+    if (smp_mtu_auto == true)
+    {
+        negotiate_link_parameters();
+    }
+
     exit_code = (this->*supported_groups[active_group_index].commands[active_command_index].run_function)(&parser);
 
     if (exit_code != EXIT_CODE_SUCCESS)
@@ -925,6 +1016,12 @@ void command_processor::add_transport_options_uart(QList<entry_t> *entries)
     entries->append({{&option_transport_uart_parity}, false, false});
     entries->append({{&option_transport_uart_data_bits}, false, false});
     entries->append({{&option_transport_uart_stop_bits}, false, false});
+    entries->append({{&option_transport_uart_framing}, false, false});
+    entries->append({{&option_transport_uart_line_size}, false, false});
+    entries->append({{&option_transport_uart_line_gap}, false, false});
+    entries->append({{&option_transport_uart_io_thread}, false, false});
+    entries->append({{&option_transport_uart_latency_statistics}, false, false});
+    entries->append({{&option_transport_uart_low_latency}, false, false});
 }
 
 int command_processor::configure_transport_options_uart(smp_transport *transport, QCommandLineParser *parser)
@@ -1056,7 +1153,77 @@ int command_processor::configure_transport_options_uart(smp_transport *transport
         uart_configuration.stop_bits = SMP_UART_STOP_BITS_1;
     }
 
-    static_cast<smp_uart *>(transport)->set_connection_config(&uart_configuration);
+    if (parser->isSet(option_transport_uart_framing) == true)
+    {
+        if (parser->value(option_transport_uart_framing) == "console")
+        {
+            uart_configuration.framing = SMP_UART_FRAMING_CONSOLE;
+        }
+        else if (parser->value(option_transport_uart_framing) == "cobs")
+        {
+            uart_configuration.framing = SMP_UART_FRAMING_COBS;
+        }
+        else
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE;
+        }
+    }
+    else
+    {
+        uart_configuration.framing = SMP_UART_FRAMING_CONSOLE;
+    }
+
+    if (parser->isSet(option_transport_uart_line_size) == true)
+    {
+        bool converted = false;
+        uint32_t line_size = parser->value(option_transport_uart_line_size).toUInt(&converted);
+
+        if (converted == false)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_CONVERSION_FAILED;
+        }
+        else if (line_size < smp_uart_line_size_minimum || line_size > smp_uart_line_size_maximum)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE;
+        }
+
+        uart_configuration.line_size = line_size;
+    }
+    else
+    {
+        uart_configuration.line_size = smp_uart_line_size_default;
+    }
+
+    if (parser->isSet(option_transport_uart_line_gap) == true)
+    {
+        bool converted = false;
+        uint32_t line_gap = parser->value(option_transport_uart_line_gap).toUInt(&converted);
+
+        if (converted == false)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_CONVERSION_FAILED;
+        }
+        else if (line_gap > maximum_transport_uart_line_gap)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE;
+        }
+
+        uart_configuration.line_gap = line_gap;
+    }
+    else
+    {
+        uart_configuration.line_gap = 0;
+    }
+
+    uart_configuration.io_thread = parser->isSet(option_transport_uart_io_thread);
+    uart_configuration.latency_statistics = parser->isSet(option_transport_uart_latency_statistics);
+    uart_configuration.low_latency = parser->isSet(option_transport_uart_low_latency);
+
+    if (static_cast<smp_uart *>(transport)->set_connection_config(&uart_configuration) != SMP_TRANSPORT_ERROR_OK)
+    {
+        return EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE;
+    }
+
     return EXIT_CODE_SUCCESS;
 }
 #endif
@@ -1419,124 +1586,251 @@ void command_processor::add_group_img_command_upload(QList<entry_t> *entries)
     entries->append({{&option_command_img_upgrade}, false, false});
     entries->append({{&option_command_img_test, &option_command_img_confirm}, false, true});
     entries->append({{&option_command_img_reset}, false, false});
+    entries->append({{&option_command_img_resume}, false, false});
+    entries->append({{&option_command_img_skip_if_present}, false, false});
+    entries->append({{&option_command_img_verify}, false, false});
+    entries->append({{&option_command_img_verify_confirm}, false, false});
+    entries->append({{&option_command_img_verify_timeout}, false, false});
 }
 
 int command_processor::run_group_img_command_upload(QCommandLineParser *parser)
 {
-    mode = ACTION_IMG_UPLOAD;
+    QStringList image_values = parser->values(option_command_img_image);
+    enum image_upload_stage_t stage;
+    uint8_t i = 0;
+
+    upload_files = parser->values(option_command_img_file);
+
+    if (upload_files.length() > maximum_upload_images)
+    {
+        fputs(qPrintable(tr("A multi-image update supports at most ") % QString::number(maximum_upload_images) % tr(" --file arguments") % newline), stdout);
+        return EXIT_CODE_ARGUMENT_VALUE_NOT_VALID;
+    }
+
+    if (image_values.length() > upload_files.length() || (upload_files.length() > 1 && image_values.length() != upload_files.length()))
+    {
+        fputs(qPrintable(tr("Each --file of a multi-image update needs an --image number") % newline), stdout);
+        return EXIT_CODE_ARGUMENT_VALUE_NOT_VALID;
+    }
+
+    upload_images.clear();
+
+    while (i < upload_files.length())
+    {
+        bool converted = true;
+        uint32_t image = (image_values.length() > i ? image_values[i].toUInt(&converted) : 0);
+
+        if (converted == false)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_CONVERSION_FAILED;
+        }
+
+        if (upload_images.contains(image) == true)
+        {
+            //A second file for the same image would overwrite the first in the secondary slot
+            fputs(qPrintable(tr("Image ") % QString::number(image) % tr(" is given more than once, each --image number must be unique") % newline), stdout);
+            return EXIT_CODE_ARGUMENT_VALUE_NOT_VALID;
+        }
+
+        upload_images.append(image);
+        ++i;
+    }
+
+    upload_verify_timeout_ms = default_verify_timeout_s * 1000;
+
+    if (parser->isSet(option_command_img_verify_timeout) == true)
+    {
+        bool converted = false;
+        uint32_t verify_timeout = parser->value(option_command_img_verify_timeout).toUInt(&converted);
+
+        if (converted == false)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_CONVERSION_FAILED;
+        }
+
+        if (verify_timeout < 1 || verify_timeout > maximum_verify_timeout_s)
+        {
+            fputs(qPrintable(tr("Argument out of range: ") % "--" % option_command_img_verify_timeout.names().first() % newline), stdout);
+            return EXIT_CODE_NUMERIAL_ARGUMENT_OUT_OF_RANGE;
+        }
+
+        upload_verify_timeout_ms = verify_timeout * 1000;
+    }
+
     upload_mode = (parser->isSet(option_command_img_test) == true ? IMAGE_UPLOAD_MODE_TEST : (parser->isSet(option_command_img_confirm) == true ? IMAGE_UPLOAD_MODE_CONFIRM : IMAGE_UPLOAD_MODE_NORMAL));
     upload_reset = parser->isSet(option_command_img_reset);
-    set_group_transport_settings(active_group);
+    upload_verify = (upload_reset == true && parser->isSet(option_command_img_verify) == true);
+    upload_verify_confirm = (upload_verify == true && upload_mode == IMAGE_UPLOAD_MODE_TEST && parser->isSet(option_command_img_verify_confirm) == true);
+    command_exit_code = EXIT_CODE_SUCCESS;
+    upload_upgrade = parser->isSet(option_command_img_upgrade);
+    upload_resume = parser->isSet(option_command_img_resume);
+    upload_skip_if_present = parser->isSet(option_command_img_skip_if_present);
+    upload_transport = session_transport;
+    upload_mark_hashes.clear();
+    upload_pending_hashes.clear();
+    upload_index = 0;
+    upload_mark_index = 0;
 
-    if (group_img->start_firmware_update((parser->isSet(option_command_img_image) ? parser->value(option_command_img_image).toUInt() : 0), parser->value(option_command_img_file), (parser->isSet(option_command_img_upgrade) ? true : false), &upload_hash, timeout_erase_ms) == true)
+    if (parser->isSet(option_transport_uart_port) == true)
     {
-        return EXIT_CODE_SUCCESS;
+        upload_transport.append(":" % parser->value(option_transport_uart_port));
     }
 
-    return EXIT_CODE_TODO_AA;
-}
+    if (upload_resume == true)
+    {
+        //The device continues any upload of the same image by itself, --resume ensures that the upload being continued is one of these
+        i = 0;
 
-void command_processor::add_group_img_command_erase_slot(QList<entry_t> *entries)
-{
-    //slot
-    entries->append({{&option_command_img_slot}, true, false});
-}
+        while (i < upload_files.length() && upload_state_matches(QFileInfo(upload_files[i]).absoluteFilePath(), upload_images[i]) == false)
+        {
+            ++i;
+        }
 
-int command_processor::run_group_img_command_erase_slot(QCommandLineParser *parser)
-{
-    mode = ACTION_IMG_IMAGE_ERASE;
-    set_group_transport_settings(active_group, timeout_erase_ms);
+        if (i == upload_files.length())
+        {
+            fputs(qPrintable(tr("No interrupted upload of the given file(s) was found, run without --resume to start a new upload") % newline), stdout);
+            return EXIT_CODE_ARGUMENT_VALUE_NOT_VALID;
+        }
+    }
 
-    if (group_img->start_image_erase(parser->value(option_command_img_slot).toUInt()) == true)
+    stage = upload_start_image();
+
+    if (stage == IMAGE_UPLOAD_STAGE_FAILED)
     {
-        return EXIT_CODE_SUCCESS;
+        return EXIT_CODE_TODO_AA;
     }
+    else if (stage == IMAGE_UPLOAD_STAGE_FINISHED && upload_reset == true && upload_pending_hashes.isEmpty() == false)
+    {
+        //Every image was already present, but some are only pending and need the reset to run
+        fputs(qPrintable(tr("Images are already present on the device, resetting to run the pending image(s)") % newline), stdout);
 
-    return EXIT_CODE_TODO_AA;
+        if (upload_start_reset() == false)
+        {
+            return EXIT_CODE_TODO_AA;
+        }
+    }
+    else if (stage == IMAGE_UPLOAD_STAGE_FINISHED)
+    {
+        //Every image was already present and needed nothing further
+        fputs(qPrintable(tr("Images are already present on the device, nothing to do") % newline), stdout);
+        mode = ACTION_IDLE;
+        return_status(EXIT_CODE_SUCCESS);
+    }
+
+    return EXIT_CODE_SUCCESS;
 }
 
-int command_processor::run_group_img_command_slot_info(QCommandLineParser *parser)
+enum image_upload_stage_t command_processor::upload_start_image()
 {
-    //TODO
-    img_mgmt_slot_info_images = new QList<slot_info_t>();
-    mode = ACTION_IMG_IMAGE_SLOT_INFO;
-    set_group_transport_settings(active_group);
+    mode = ACTION_IMG_UPLOAD;
+    upload_file = QFileInfo(upload_files[upload_index]).absoluteFilePath();
+    upload_image = upload_images[upload_index];
+    upload_progress = 0;
 
-    if (group_img->start_image_slot_info(img_mgmt_slot_info_images) == true)
+    if (upload_files.length() > 1)
     {
-        return EXIT_CODE_SUCCESS;
+        fputs(qPrintable(tr("Image ") % QString::number(upload_image) % " (" % QString::number(upload_index + 1) % "/" % QString::number(upload_files.length()) % "): " % upload_file % newline), stdout);
     }
 
-    return EXIT_CODE_TODO_AA;
-}
+    if (upload_skip_if_present == true)
+    {
+        mcuboot_image local_image;
+        enum mcuboot_image_error_t image_error = local_image.load(upload_file);
+        bool active = false;
+        bool pending = false;
+        bool confirmed = false;
 
-void command_processor::add_group_os_command_echo(QList<entry_t> *entries)
-{
-    //data
-    entries->append({{&option_command_os_data}, true, false});
-}
+        if (image_error != MCUBOOT_IMAGE_ERROR_OK)
+        {
+            fputs(qPrintable(tr("Warning: unable to read image hash, uploading: ") % mcuboot_image::error_string(image_error) % newline), stdout);
+        }
+        else if (upload_image_present(local_image.hash(), upload_image, &active, &pending, &confirmed) == true)
+        {
+            //Images which are already in the requested state are left alone, others are marked with the uploaded images
+            if ((upload_mode == IMAGE_UPLOAD_MODE_TEST && active == false && pending == false) || (upload_mode == IMAGE_UPLOAD_MODE_CONFIRM && confirmed == false))
+            {
+                upload_mark_hashes.append(local_image.hash());
+            }
+            else if (pending == true && active == false)
+            {
+                //Already marked, but only runs once the device has been reset
+                upload_pending_hashes.append(local_image.hash());
+            }
 
-int command_processor::run_group_os_command_echo(QCommandLineParser *parser)
-{
-    //data
-    mode = ACTION_OS_ECHO;
-    set_group_transport_settings(active_group);
+            fputs(qPrintable(tr("Image is already present on the device, skipping upload") % newline), stdout);
 
-    if (group_os->start_echo(parser->value(option_command_os_data)) == true)
+            return upload_next_image();
+        }
+    }
+
+    //The device keeps its upload offset for an image with the same hash and reports it in response to the first chunk
+    if (upload_resume == true && upload_state_matches(upload_file, upload_image) == true)
     {
-        return EXIT_CODE_SUCCESS;
+        QSettings settings("qtmgmt", "qtmgmt");
+
+        fputs(qPrintable(tr("Resuming interrupted upload, last at ") % QString::number(settings.value("upload/progress", 0).toUInt()) % "%" % newline), stdout);
     }
 
-    return EXIT_CODE_TODO_AA;
+    processor->set_transport(active_transport);
+    set_group_transport_settings(group_img);
+
+    if (group_img->start_firmware_update(upload_image, upload_file, upload_upgrade, &upload_hash, timeout_erase_ms) == true)
+    {
+        upload_state_save();
+        return IMAGE_UPLOAD_STAGE_STARTED;
+    }
+
+    return IMAGE_UPLOAD_STAGE_FAILED;
 }
 
-int command_processor::run_group_os_command_task_list(QCommandLineParser *parser)
+enum image_upload_stage_t command_processor::upload_next_image()
 {
-    //TODO
-    os_mgmt_task_list = new QList<task_list_t>();
-    mode = ACTION_OS_TASK_STATS;
-    set_group_transport_settings(active_group);
+    ++upload_index;
 
-    if (group_os->start_task_stats(os_mgmt_task_list) == true)
+    if (upload_index < upload_files.length())
     {
-        return EXIT_CODE_SUCCESS;
+        return upload_start_image();
     }
 
-    return EXIT_CODE_TODO_AA;
+    return upload_mark_next_image();
 }
 
-int command_processor::run_group_os_command_memory_pool(QCommandLineParser *parser)
+enum image_upload_stage_t command_processor::upload_mark_next_image()
 {
-    //TODO
-    os_mgmt_memory_pool = new QList<memory_pool_t>();
-    mode = ACTION_OS_MEMORY_POOL;
-    set_group_transport_settings(active_group);
+    if (upload_mark_index >= upload_mark_hashes.length())
+    {
+        return IMAGE_UPLOAD_STAGE_FINISHED;
+    }
 
-    if (group_os->start_memory_pool(os_mgmt_memory_pool) == true)
+    //Mark image for test or confirmation
+    mode = ACTION_IMG_UPLOAD_SET;
+    upload_hash = upload_mark_hashes[upload_mark_index];
+    ++upload_mark_index;
+
+    processor->set_transport(active_transport);
+    set_group_transport_settings(group_img);
+
+    if (group_img->start_image_set(&upload_hash, (upload_mode == IMAGE_UPLOAD_MODE_CONFIRM ? true : false), nullptr) == true)
     {
-        return EXIT_CODE_SUCCESS;
+        log_debug() << "do upload of " << upload_hash;
+        return IMAGE_UPLOAD_STAGE_STARTED;
     }
 
-    return EXIT_CODE_TODO_AA;
+    return IMAGE_UPLOAD_STAGE_FAILED;
 }
 
-void command_processor::add_group_os_command_reset(QList<entry_t> *entries)
+void command_processor::add_group_img_command_erase_slot(QList<entry_t> *entries)
 {
-    //force, boot mode
-    entries->append({{&option_command_os_force}, false, false});
-    entries->append({{&option_command_os_boot_mode}, false, false});
+    //slot
+    entries->append({{&option_command_img_slot}, true, false});
 }
 
-int command_processor::run_group_os_command_reset(QCommandLineParser *parser)
+int command_processor::run_group_img_command_erase_slot(QCommandLineParser *parser)
 {
-    //force, boot mode
-    uint8_t boot_mode;
-
-    mode = ACTION_OS_RESET;
-    boot_mode = (parser->isSet(option_command_os_boot_mode) == true ? parser->value(option_command_os_boot_mode).toUInt() : 0);
-    set_group_transport_settings(active_group);
+    mode = ACTION_IMG_IMAGE_ERASE;
+    set_group_transport_settings(active_group, timeout_erase_ms);
 
-    if (group_os->start_reset(parser->isSet(option_command_os_force), boot_mode) == true)
+    if (group_img->start_image_erase(parser->value(option_command_img_slot).toUInt()) == true)
     {
         return EXIT_CODE_SUCCESS;
     }
@@ -1544,37 +1838,251 @@ int command_processor::run_group_os_command_reset(QCommandLineParser *parser)
     return EXIT_CODE_TODO_AA;
 }
 
-int command_processor::run_group_os_command_mcumgr_parameters(QCommandLineParser *parser)
+int command_processor::run_group_img_command_slot_info(QCommandLineParser *parser)
 {
-    mode = ACTION_OS_MCUMGR_BUFFER;
+    //TODO
+    img_mgmt_slot_info_images = new QList<slot_info_t>();
+    mode = ACTION_IMG_IMAGE_SLOT_INFO;
     set_group_transport_settings(active_group);
 
-    if (group_os->start_mcumgr_parameters(&os_mgmt_mcumgr_parameters_buffer_size, &os_mgmt_mcumgr_parameters_buffer_count) == true)
+    if (group_img->start_image_slot_info(img_mgmt_slot_info_images) == true)
     {
         return EXIT_CODE_SUCCESS;
     }
+
+    return EXIT_CODE_TODO_AA;
 }
 
-void command_processor::add_group_os_command_application_information(QList<entry_t> *entries)
+void command_processor::add_group_img_command_inspect(QList<entry_t> *entries)
 {
-    //format
-    entries->append({{&option_command_os_format}, false, false});
+    //file, image
+    entries->append({{&option_command_img_file}, true, false});
+    entries->append({{&option_command_img_image}, false, false});
 }
 
-int command_processor::run_group_os_command_application_information(QCommandLineParser *parser)
+int command_processor::run_group_img_command_inspect(QCommandLineParser *parser)
 {
-    //format
-    os_mgmt_os_application_info_response = new QString();
-    mode = ACTION_OS_OS_APPLICATION_INFO;
-    set_group_transport_settings(active_group);
+    QStringList files = parser->values(option_command_img_file);
+    QStringList image_values = parser->values(option_command_img_image);
+    QList<uint32_t> images;
+    int result = EXIT_CODE_SUCCESS;
+    uint16_t i = 0;
 
-    if (group_os->start_os_application_info((parser->isSet(option_command_os_format) == true ? parser->value(option_command_os_format) : ""), os_mgmt_os_application_info_response) == true)
+    //A single --image applies to every file, otherwise one is needed for each
+    if (image_values.length() > 1 && image_values.length() != files.length())
     {
-        return EXIT_CODE_SUCCESS;
+        fputs(qPrintable(tr("Give a single --image or one for each --file") % newline), stdout);
+        return EXIT_CODE_ARGUMENT_VALUE_NOT_VALID;
     }
 
-    return EXIT_CODE_TODO_AA;
-}
+    while (i < files.length())
+    {
+        bool converted = true;
+
+        images.append((image_values.length() > 0 ? image_values[(image_values.length() > 1 ? i : 0)].toUInt(&converted) : 0));
+
+        if (converted == false)
+        {
+            return EXIT_CODE_NUMERIAL_ARGUMENT_CONVERSION_FAILED;
+        }
+
+        ++i;
+    }
+
+    i = 0;
+
+    while (i < files.length())
+    {
+        if (inspect_image_file(files[i], images[i]) == false)
+        {
+            result = EXIT_CODE_IMAGE_INVALID;
+        }
+
+        ++i;
+    }
+
+    return result;
+}
+
+bool command_processor::inspect_image_file(const QString &file_name, uint32_t image)
+{
+    mcuboot_image local_image;
+    enum mcuboot_image_error_t image_error = local_image.load(file_name);
+    QString field_size;
+    uint32_t max_image_size;
+    bool valid = true;
+
+    fputs(qPrintable(tr("File: ") % file_name % newline), stdout);
+
+    if (image_error != MCUBOOT_IMAGE_ERROR_OK)
+    {
+        fputs(qPrintable(indent % tr("Error: ") % mcuboot_image::error_string(image_error) % newline), stdout);
+        return false;
+    }
+
+    fputs(qPrintable(indent % tr("Version: ") % local_image.version_string() % newline), stdout);
+    fputs(qPrintable(indent % tr("Load address: 0x") % QString::number(local_image.load_address(), 16).rightJustified(8, '0') % newline), stdout);
+    fputs(qPrintable(indent % tr("Flags: 0x") % QString::number(local_image.flags(), 16).rightJustified(8, '0') % newline), stdout);
+    fputs(qPrintable(indent % tr("Header size: ") % QString::number(local_image.header_size()) % newline), stdout);
+    fputs(qPrintable(indent % tr("Image size: ") % QString::number(local_image.image_size()) % newline), stdout);
+    size_abbreviation(local_image.total_size(), &field_size);
+    fputs(qPrintable(indent % tr("Total size: ") % QString::number(local_image.total_size()) % " (" % field_size % ")" % newline), stdout);
+    field_size.clear();
+    fputs(qPrintable(indent % tr("Hash: ") % local_image.hash().toHex() % newline), stdout);
+
+    if (local_image.hash_type() != mcuboot_image_tlv_sha256)
+    {
+        fputs(qPrintable(indent % tr("Hash check: skipped, only SHA-256 is supported") % newline), stdout);
+    }
+    else if ((local_image.flags() & (mcuboot_image_flag_encrypted_aes128 | mcuboot_image_flag_encrypted_aes256)) != 0)
+    {
+        //imgtool hashes the plaintext, which is not available for encrypted images
+        fputs(qPrintable(indent % tr("Hash check: skipped, image is encrypted") % newline), stdout);
+    }
+    else
+    {
+        uint8_t digest[sha256_digest_size];
+
+        sha256_calculate((const uint8_t *)local_image.data().constData(), local_image.hashed_size(), digest);
+
+        if (QByteArray::fromRawData((const char *)digest, sha256_digest_size) == local_image.hash())
+        {
+            fputs(qPrintable(indent % tr("Hash check: passed") % newline), stdout);
+        }
+        else
+        {
+            fputs(qPrintable(indent % tr("Hash check: failed, calculated ") % QByteArray((const char *)digest, sha256_digest_size).toHex() % newline), stdout);
+            valid = false;
+        }
+    }
+
+    if (slot_info_cached_max_image_size(image, &max_image_size) == true)
+    {
+        size_abbreviation(max_image_size, &field_size);
+
+        if (local_image.total_size() > max_image_size)
+        {
+            fputs(qPrintable(indent % tr("Size check: failed, image ") % QString::number(image) % tr(" allows at most ") % field_size % newline), stdout);
+            valid = false;
+        }
+        else
+        {
+            fputs(qPrintable(indent % tr("Size check: passed, image ") % QString::number(image) % tr(" allows up to ") % field_size % newline), stdout);
+        }
+    }
+    else
+    {
+        fputs(qPrintable(indent % tr("Size check: skipped, maximum size of image ") % QString::number(image) % tr(" is unknown (run image slot-info to cache it)") % newline), stdout);
+    }
+
+    return valid;
+}
+
+void command_processor::add_group_os_command_echo(QList<entry_t> *entries)
+{
+    //data
+    entries->append({{&option_command_os_data}, true, false});
+}
+
+int command_processor::run_group_os_command_echo(QCommandLineParser *parser)
+{
+    //data
+    mode = ACTION_OS_ECHO;
+    set_group_transport_settings(active_group);
+
+    if (group_os->start_echo(parser->value(option_command_os_data)) == true)
+    {
+        return EXIT_CODE_SUCCESS;
+    }
+
+    return EXIT_CODE_TODO_AA;
+}
+
+int command_processor::run_group_os_command_task_list(QCommandLineParser *parser)
+{
+    //TODO
+    os_mgmt_task_list = new QList<task_list_t>();
+    mode = ACTION_OS_TASK_STATS;
+    set_group_transport_settings(active_group);
+
+    if (group_os->start_task_stats(os_mgmt_task_list) == true)
+    {
+        return EXIT_CODE_SUCCESS;
+    }
+
+    return EXIT_CODE_TODO_AA;
+}
+
+int command_processor::run_group_os_command_memory_pool(QCommandLineParser *parser)
+{
+    //TODO
+    os_mgmt_memory_pool = new QList<memory_pool_t>();
+    mode = ACTION_OS_MEMORY_POOL;
+    set_group_transport_settings(active_group);
+
+    if (group_os->start_memory_pool(os_mgmt_memory_pool) == true)
+    {
+        return EXIT_CODE_SUCCESS;
+    }
+
+    return EXIT_CODE_TODO_AA;
+}
+
+void command_processor::add_group_os_command_reset(QList<entry_t> *entries)
+{
+    //force, boot mode
+    entries->append({{&option_command_os_force}, false, false});
+    entries->append({{&option_command_os_boot_mode}, false, false});
+}
+
+int command_processor::run_group_os_command_reset(QCommandLineParser *parser)
+{
+    //force, boot mode
+    uint8_t boot_mode;
+
+    mode = ACTION_OS_RESET;
+    boot_mode = (parser->isSet(option_command_os_boot_mode) == true ? parser->value(option_command_os_boot_mode).toUInt() : 0);
+    set_group_transport_settings(active_group);
+
+    if (group_os->start_reset(parser->isSet(option_command_os_force), boot_mode) == true)
+    {
+        return EXIT_CODE_SUCCESS;
+    }
+
+    return EXIT_CODE_TODO_AA;
+}
+
+int command_processor::run_group_os_command_mcumgr_parameters(QCommandLineParser *parser)
+{
+    mode = ACTION_OS_MCUMGR_BUFFER;
+    set_group_transport_settings(active_group);
+
+    if (group_os->start_mcumgr_parameters(&os_mgmt_mcumgr_parameters_buffer_size, &os_mgmt_mcumgr_parameters_buffer_count) == true)
+    {
+        return EXIT_CODE_SUCCESS;
+    }
+}
+
+void command_processor::add_group_os_command_application_information(QList<entry_t> *entries)
+{
+    //format
+    entries->append({{&option_command_os_format}, false, false});
+}
+
+int command_processor::run_group_os_command_application_information(QCommandLineParser *parser)
+{
+    //format
+    os_mgmt_os_application_info_response = new QString();
+    mode = ACTION_OS_OS_APPLICATION_INFO;
+    set_group_transport_settings(active_group);
+
+    if (group_os->start_os_application_info((parser->isSet(option_command_os_format) == true ? parser->value(option_command_os_format) : ""), os_mgmt_os_application_info_response) == true)
+    {
+        return EXIT_CODE_SUCCESS;
+    }
+
+    return EXIT_CODE_TODO_AA;
+}
 
 int command_processor::run_group_os_command_get_time_and_date(QCommandLineParser *parser)
 {
@@ -1691,12 +2199,206 @@ int command_processor::run_group_stats_command_list_groups(QCommandLineParser *p
 
 void command_processor::set_group_transport_settings(smp_group *group)
 {
-    group->set_parameters(smp_v2, smp_mtu, active_transport->get_retries(), active_transport->get_timeout(), mode);
+    set_group_transport_settings(group, 0);
 }
 
 void command_processor::set_group_transport_settings(smp_group *group, uint32_t timeout)
 {
-    group->set_parameters(smp_v2, smp_mtu, active_transport->get_retries(), (timeout >= active_transport->get_timeout() ? timeout : active_transport->get_timeout()), mode);
+    set_group_transport_settings(group, timeout, active_transport->get_retries());
+}
+
+void command_processor::set_group_transport_settings(smp_group *group, uint32_t timeout, uint8_t retries)
+{
+    uint32_t group_timeout;
+
+    timeout_group = group;
+    timeout_floor_ms = timeout;
+    timeout_retries = retries;
+
+    if (adaptive_timeout == true)
+    {
+        //Transport timeout is only used until round trip times have been measured, timeout is the minimum for slow commands e.g. erase
+        group_timeout = round_trip_estimator.timeout_ms(active_transport->get_timeout(), timeout);
+    }
+    else
+    {
+        group_timeout = (timeout >= active_transport->get_timeout() ? timeout : active_transport->get_timeout());
+    }
+
+    group->set_parameters(smp_v2, smp_mtu, retries, group_timeout, mode);
+}
+
+group_status command_processor::wait_for_group(smp_group *group, uint8_t *header_version)
+{
+    QEventLoop wait_loop;
+    group_status result = STATUS_ERROR;
+    QMetaObject::Connection status_connection;
+    QMetaObject::Connection receive_connection;
+
+    //The group times out by itself, so there is no need for a timer here
+    status_connection = connect(group, &smp_group::status, &wait_loop, [&wait_loop, &result](uint8_t user_data, group_status status, QString error_string)
+    {
+        Q_UNUSED(user_data);
+        Q_UNUSED(error_string);
+        result = status;
+        wait_loop.quit();
+    });
+
+    //Responses carry the SMP version supported by the device in bits 3-4 of the first header byte, even when the command failed
+    receive_connection = connect(active_transport, &smp_transport::receive_waiting, this, [header_version](smp_message *message)
+    {
+        if (message->data()->length() > 0)
+        {
+            *header_version = ((uint8_t)message->data()->at(0) >> 3) & 0x03;
+        }
+    });
+
+    wait_loop.exec();
+
+    disconnect(status_connection);
+    disconnect(receive_connection);
+    request_given_up(result);
+
+    return result;
+}
+
+void command_processor::negotiate_link_parameters()
+{
+    smp_group_os_mgmt negotiation_group(processor);
+    uint8_t header_version = 0xff;
+    uint32_t buffer_size = 0;
+    uint32_t buffer_count = 0;
+    group_status result;
+    bool negotiated_v2 = (smp_version_set == true ? smp_v2 : true);
+
+    //Ask the device for its buffer size, version 2 is requested so that the response shows what the device supports
+    negotiation_group.set_parameters(negotiated_v2, minimum_smp_mtu, active_transport->get_retries(), active_transport->get_timeout(), ACTION_OS_MCUMGR_BUFFER);
+
+    if (negotiation_group.start_mcumgr_parameters(&buffer_size, &buffer_count) == true)
+    {
+        result = wait_for_group(&negotiation_group, &header_version);
+    }
+    else
+    {
+        result = STATUS_ERROR;
+    }
+
+    if (smp_version_set == false && header_version != 0xff)
+    {
+        negotiated_v2 = (header_version >= 1);
+    }
+
+    if (result == STATUS_COMPLETE && buffer_size > 0)
+    {
+        uint32_t mtu = buffer_size;
+
+#if defined(PLUGIN_MCUMGR_TRANSPORT_UART)
+        if (active_transport == transport_uart)
+        {
+            //The buffer holds the decoded message together with its length prefix and CRC, the UART MTU is the size of the frame on the wire
+            uint32_t message_size = (buffer_size > smp_uart_frame_overhead ? (buffer_size - smp_uart_frame_overhead) : 0);
+
+            mtu = transport_uart->framed_size((message_size > 0xffff ? 0xffff : message_size));
+        }
+#endif
+
+        smp_mtu = (mtu < minimum_smp_mtu ? minimum_smp_mtu : (mtu > maximum_smp_mtu ? maximum_smp_mtu : mtu));
+        fputs(qPrintable(tr("Negotiated MTU: ") % QString::number(smp_mtu) % tr(" (device buffer size: ") % QString::number(buffer_size) % tr(", count: ") % QString::number(buffer_count) % tr("), SMP version: ") % (negotiated_v2 == true ? "2" : "1") % newline), stdout);
+    }
+    else
+    {
+        //MCUmgr parameters are not supported, find the largest echo which the device answers
+        uint16_t working = 0;
+        uint16_t lower = minimum_smp_mtu;
+        uint16_t upper = maximum_smp_mtu_probe;
+
+        while (lower <= upper)
+        {
+            uint16_t probe = lower + ((upper - lower) / 2);
+            uint16_t data_size = active_transport->max_message_data_size(probe);
+
+            if (data_size <= smp_echo_overhead)
+            {
+                lower = probe + 1;
+                continue;
+            }
+
+            //A single attempt per size, devices commonly drop oversized messages without replying
+            negotiation_group.set_parameters(negotiated_v2, probe, 0, active_transport->get_timeout(), ACTION_OS_ECHO);
+
+            if (negotiation_group.start_echo(QString((data_size - smp_echo_overhead), QChar('a'))) == true && wait_for_group(&negotiation_group, &header_version) == STATUS_COMPLETE)
+            {
+                working = probe;
+                lower = probe + 1;
+            }
+            else if (working == 0 && probe == minimum_smp_mtu)
+            {
+                break;
+            }
+            else
+            {
+                upper = probe - 1;
+            }
+        }
+
+        if (smp_version_set == false && header_version != 0xff)
+        {
+            negotiated_v2 = (header_version >= 1);
+        }
+
+        if (working == 0)
+        {
+            fputs(qPrintable(tr("Warning: MTU negotiation failed, using: ") % QString::number(smp_mtu) % newline), stdout);
+            return;
+        }
+
+        smp_mtu = working;
+        fputs(qPrintable(tr("Probed MTU: ") % QString::number(smp_mtu) % tr(", SMP version: ") % (negotiated_v2 == true ? "2" : "1") % newline), stdout);
+    }
+
+    smp_v2 = negotiated_v2;
+}
+
+void command_processor::transport_round_trip_sample(uint32_t rtt_us)
+{
+    round_trip_estimator.add_sample(rtt_us);
+
+    if (adaptive_timeout == true && timeout_group != nullptr)
+    {
+        //Applies from the next request sent by the group
+        set_group_transport_settings(timeout_group, timeout_floor_ms, timeout_retries);
+    }
+}
+
+void command_processor::transport_request_retry()
+{
+    //The previous attempt timed out, back off until a response gives a new sample
+    round_trip_estimator.backoff();
+
+    if (adaptive_timeout == true && timeout_group != nullptr)
+    {
+        set_group_transport_settings(timeout_group, timeout_floor_ms, timeout_retries);
+    }
+}
+
+void command_processor::request_given_up(group_status status)
+{
+    if (status != STATUS_TIMEOUT && status != STATUS_CANCELLED)
+    {
+        return;
+    }
+
+    if (status == STATUS_TIMEOUT)
+    {
+        round_trip_estimator.backoff();
+    }
+
+#if defined(PLUGIN_MCUMGR_TRANSPORT_UART)
+    if (transport_uart != nullptr && active_transport == transport_uart)
+    {
+        transport_uart->request_abandoned();
+    }
+#endif
 }
 
 void command_processor::status(uint8_t user_data, group_status status, QString error_string)
@@ -1718,60 +2420,94 @@ void command_processor::status(uint8_t user_data, group_status status, QString e
 
 //    log_debug() << "Status: " << status;
 
+    request_given_up(status);
+
     if (sender() == group_img)
     {
         log_debug() << "img sender";
 
-        if (status == STATUS_COMPLETE)
+        if (user_data == ACTION_IMG_UPLOAD_VERIFY)
         {
-            log_debug() << "complete";
+            finished = upload_verify_response(status);
+            skip_error_string = true;
+        }
+        else if (user_data == ACTION_IMG_UPLOAD_CONFIRM && status != STATUS_COMPLETE)
+        {
+            command_exit_code = EXIT_CODE_VERIFY_FAILED;
+        }
+        else if (user_data == ACTION_IMG_UPLOAD_CONFIRM && upload_mark_index < upload_mark_hashes.length())
+        {
+            //Confirm the next image of a multi-image update
+            finished = false;
+            upload_hash = upload_mark_hashes[upload_mark_index];
+            ++upload_mark_index;
+            set_group_transport_settings(group_img);
 
-            //Advance to next stage of image upload
-            if (user_data == ACTION_IMG_UPLOAD)
+            if (group_img->start_image_set(&upload_hash, true, nullptr) == false)
             {
-                log_debug() << "is upload";
-                if (upload_mode == IMAGE_UPLOAD_MODE_TEST || upload_mode == IMAGE_UPLOAD_MODE_CONFIRM)
-                {
-                    //Mark image for test or confirmation
-                    finished = false;
-
-                    mode = ACTION_IMG_UPLOAD_SET;
-                    processor->set_transport(active_transport);
-                    set_group_transport_settings(group_img);
-                    bool started = group_img->start_image_set(&upload_hash, (upload_mode == IMAGE_UPLOAD_MODE_CONFIRM ? true : false), nullptr);
-                    //todo: check status
+                finished = true;
+                status = STATUS_ERROR;
+            }
+        }
 
-                    log_debug() << "do upload of " << upload_hash;
-                }
+        if (user_data == ACTION_IMG_UPLOAD)
+        {
+            //Keep the state of an upload which did not finish so that it can be resumed
+            if (status == STATUS_COMPLETE)
+            {
+                upload_state_clear();
             }
-            else if (user_data == ACTION_IMG_UPLOAD_SET)
+            else
             {
-                if (upload_reset == true)
-                {
-                    //Reboot device
-                    finished = false;
+                upload_state_save();
+            }
+        }
 
-                    //Clean up of previous group
-                    disconnect(active_group, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
-                    disconnect(active_group, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
-                    delete active_group;
-                    active_group = nullptr;
+        if (status == STATUS_COMPLETE)
+        {
+            log_debug() << "complete";
 
-                    //Set up OS management group
-                    group_os = new smp_group_os_mgmt(processor);
-                    active_group = group_os;
+            //Advance to next stage of image upload
+            if (user_data == ACTION_IMG_UPLOAD || user_data == ACTION_IMG_UPLOAD_SET)
+            {
+                enum image_upload_stage_t stage;
 
-                    connect(group_os, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
-                    connect(group_os, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
+                if (user_data == ACTION_IMG_UPLOAD)
+                {
+                    log_debug() << "is upload";
 
-                    mode = ACTION_OS_UPLOAD_RESET;
-                    processor->set_transport(active_transport);
-                    set_group_transport_settings(group_os);
+                    if (upload_mode == IMAGE_UPLOAD_MODE_TEST || upload_mode == IMAGE_UPLOAD_MODE_CONFIRM)
+                    {
+                        upload_mark_hashes.append(upload_hash);
+                    }
 
-                    bool started = group_os->start_reset(false, 0);
-                    //todo: check status
+                    //Next image of a multi-image update, or marking once all have been uploaded
+                    stage = upload_next_image();
+                }
+                else
+                {
+                    stage = upload_mark_next_image();
+                }
 
-                    log_debug() << "do reset";
+                if (stage == IMAGE_UPLOAD_STAGE_STARTED)
+                {
+                    finished = false;
+                }
+                else if (stage == IMAGE_UPLOAD_STAGE_FAILED)
+                {
+                    status = STATUS_ERROR;
+                }
+                else if (upload_reset == true && (user_data == ACTION_IMG_UPLOAD_SET || upload_pending_hashes.isEmpty() == false))
+                {
+                    //Reboot device
+                    if (upload_start_reset() == true)
+                    {
+                        finished = false;
+                    }
+                    else
+                    {
+                        status = STATUS_ERROR;
+                    }
                 }
             }
             else if (user_data == ACTION_IMG_IMAGE_LIST || user_data == ACTION_IMG_IMAGE_SET)
@@ -1873,6 +2609,9 @@ void command_processor::status(uint8_t user_data, group_status status, QString e
                         size_abbreviation((*img_mgmt_slot_info_images)[i].max_image_size, &field_size);
                         fputs(qPrintable(indent % tr("Max image size: ") % field_size % newline), stdout);
                         field_size.clear();
+
+                        //Kept for image inspect, which checks local files against it without a device
+                        slot_info_cache_max_image_size((*img_mgmt_slot_info_images)[i].image, (*img_mgmt_slot_info_images)[i].max_image_size);
                     }
 
                     ++i;
@@ -1891,29 +2630,14 @@ void command_processor::status(uint8_t user_data, group_status status, QString e
                 if (upload_reset == true)
                 {
                     //Reboot device
-                    finished = false;
-
-                    //Clean up of previous group
-                    disconnect(active_group, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
-                    disconnect(active_group, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
-                    delete active_group;
-                    active_group = nullptr;
-
-                    //Set up OS management group
-                    group_os = new smp_group_os_mgmt(processor);
-                    active_group = group_os;
-
-                    connect(group_os, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
-                    connect(group_os, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
-
-                    mode = ACTION_OS_UPLOAD_RESET;
-                    processor->set_transport(active_transport);
-                    set_group_transport_settings(group_os);
-
-                    bool started = group_os->start_reset(false, 0);
-                    //todo: check status
-
-                    log_debug() << "do reset";
+                    if (upload_start_reset() == true)
+                    {
+                        finished = false;
+                    }
+                    else
+                    {
+                        status = STATUS_ERROR;
+                    }
                 }
                 else
                 {
@@ -1938,6 +2662,18 @@ void command_processor::status(uint8_t user_data, group_status status, QString e
         log_debug() << "os sender";
 //        label_status = lbl_OS_Status;
 
+        if (user_data == ACTION_OS_UPLOAD_RESET && upload_verify == true)
+        {
+            //Wait for the device to come back, whatever the result as it may reset before the response is sent
+            finished = false;
+            skip_error_string = true;
+            upload_verify_delay_ms = verify_poll_initial_ms;
+            upload_verify_connecting = false;
+            mode = ACTION_IMG_UPLOAD_VERIFY;
+            fputs(qPrintable(tr("Waiting for device to restart") % newline), stdout);
+            upload_verify_timer.start(upload_verify_delay_ms);
+        }
+
         if (status == STATUS_COMPLETE)
         {
             log_debug() << "complete";
@@ -2334,21 +3070,391 @@ void command_processor::status(uint8_t user_data, group_status status, QString e
 
     if (finished == true)
     {
-        QCoreApplication::exit(EXIT_CODE_SUCCESS);
+        if (adaptive_timeout == true)
+        {
+            uint32_t retransmissions = 0;
+
+#if defined(PLUGIN_MCUMGR_TRANSPORT_UART)
+            if (active_transport == transport_uart)
+            {
+                struct smp_uart_round_trip_t round_trip;
+
+                transport_uart->round_trip_time(&round_trip);
+                retransmissions = round_trip.retransmissions;
+            }
+#endif
+
+            fputs(qPrintable(tr("Round trip time: smoothed ") % QString::number(round_trip_estimator.smoothed_rtt_us() / 1000.0, 'f', 1) % "ms, variation " % QString::number(round_trip_estimator.rtt_variation_us() / 1000.0, 'f', 1) % "ms, timeout " % QString::number(round_trip_estimator.timeout_ms(active_transport->get_timeout(), timeout_floor_ms)) % "ms, " % QString::number(round_trip_estimator.samples()) % " samples, " % QString::number(retransmissions) % " retries" % newline), stdout);
+        }
+
+        timeout_group = nullptr;
+        QCoreApplication::exit(command_exit_code);
     }
 }
 
 void command_processor::progress(uint8_t user_data, uint8_t percent)
 {
+    if (user_data == ACTION_IMG_UPLOAD)
+    {
+        upload_progress = percent;
+    }
+
     qDebug() << "progress: " << user_data << ", " << percent;
 }
 
 void command_processor::transport_connected()
 {
+    if (mode == ACTION_IMG_UPLOAD_VERIFY && upload_verify_connecting == true)
+    {
+        //Asynchronous reconnection after the reset has completed, poll now rather than at the next backoff
+        upload_verify_timer.stop();
+        upload_verify_poll();
+    }
+}
+
+void command_processor::terminate_requested(int signal_number)
+{
+    log_debug() << "Signal received: " << signal_number;
+
+    if (mode == ACTION_IMG_UPLOAD)
+    {
+        upload_state_save();
+        fputs(qPrintable(tr("Upload interrupted at ") % QString::number(upload_progress) % tr("%, run again with --resume to continue") % newline), stdout);
+    }
+    else
+    {
+        fputs(qPrintable(tr("Interrupted") % newline), stdout);
+    }
+
+    mode = ACTION_IDLE;
+
+    if (active_transport != nullptr && active_transport->is_connected() == 1)
+    {
+        active_transport->disconnect(true);
+    }
+
+    QCoreApplication::exit(EXIT_CODE_INTERRUPTED);
+}
+
+void command_processor::upload_verify_poll()
+{
+    if (mode != ACTION_IMG_UPLOAD_VERIFY)
+    {
+        return;
+    }
+
+    if (active_group != group_img)
+    {
+        //The reset was sent through the OS management group, go back to image management for the polls
+        disconnect(active_group, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
+        disconnect(active_group, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
+        delete active_group;
+        group_os = nullptr;
+        timeout_group = nullptr;
+
+        group_img = new smp_group_img_mgmt(processor);
+        active_group = group_img;
+
+        connect(group_img, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
+        connect(group_img, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
+    }
+
+    if (active_transport->is_connected() == 0)
+    {
+        //Devices on USB or Bluetooth drop off when they reset, so the transport is opened again. Transports which connect
+        //asynchronously (e.g. Bluetooth) are left connecting, transport_connected() then polls whilst the backoff keeps the timeout
+        if (upload_verify_connecting == false && active_transport->connect() == SMP_TRANSPORT_ERROR_OK)
+        {
+            upload_verify_connecting = (active_transport->is_connected() == 0);
+        }
+
+        if (active_transport->is_connected() == 0)
+        {
+            if (upload_verify_schedule() == false)
+            {
+                fputs(qPrintable(tr("Device did not return after the reset") % newline), stdout);
+                mode = ACTION_IDLE;
+                return_status(EXIT_CODE_VERIFY_FAILED);
+            }
+
+            return;
+        }
+    }
+
+    upload_verify_connecting = false;
+
+    if (img_mgmt_get_state_images == nullptr)
+    {
+        img_mgmt_get_state_images = new QList<image_state_t>();
+    }
+
+    img_mgmt_get_state_images->clear();
+    processor->set_transport(active_transport);
+
+    //Goes through the usual settings so that adaptive timeouts apply to, and are updated from, the polls
+    set_group_transport_settings(group_img, verify_poll_timeout_ms);
+
+    if (group_img->start_image_get(img_mgmt_get_state_images) == false && upload_verify_schedule() == false)
+    {
+        fputs(qPrintable(tr("Device did not return after the reset") % newline), stdout);
+        mode = ACTION_IDLE;
+        return_status(EXIT_CODE_VERIFY_FAILED);
+    }
+}
+
+bool command_processor::upload_verify_schedule()
+{
+    if (upload_reset_timer.elapsed() >= upload_verify_timeout_ms)
+    {
+        return false;
+    }
+
+    upload_verify_delay_ms *= 2;
+
+    if (upload_verify_delay_ms > verify_poll_maximum_ms)
+    {
+        upload_verify_delay_ms = verify_poll_maximum_ms;
+    }
+
+    upload_verify_timer.start(upload_verify_delay_ms);
+
+    return true;
+}
+
+bool command_processor::upload_start_reset()
+{
+    //Clean up of previous group
+    disconnect(active_group, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
+    disconnect(active_group, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
+    delete active_group;
+    active_group = nullptr;
+    group_img = nullptr;
+    timeout_group = nullptr;
+
+    //Images which were already pending are run by the same reset, so are verified and confirmed along with those marked
+    upload_mark_hashes.append(upload_pending_hashes);
+    upload_pending_hashes.clear();
+
+    //Set up OS management group
+    group_os = new smp_group_os_mgmt(processor);
+    active_group = group_os;
+
+    connect(group_os, SIGNAL(status(uint8_t,group_status,QString)), this, SLOT(status(uint8_t,group_status,QString)));
+    connect(group_os, SIGNAL(progress(uint8_t,uint8_t)), this, SLOT(progress(uint8_t,uint8_t)));
+
+    mode = ACTION_OS_UPLOAD_RESET;
+    processor->set_transport(active_transport);
+
+    //A device may reset before it responds, when verifying a retry could reset it again whilst it is starting the new image
+    set_group_transport_settings(group_os, 0, (upload_verify == true ? 0 : active_transport->get_retries()));
+
+    log_debug() << "do reset";
+
+    //Reset to ready is timed from the reset being sent, the response to it may never arrive
+    upload_reset_timer.start();
+
+    return group_os->start_reset(false, 0);
+}
+
+bool command_processor::upload_verify_response(group_status status)
+{
+    uint8_t i = 0;
+    uint8_t found = 0;
+
+    if (status != STATUS_COMPLETE)
+    {
+        //Not back yet, close the transport so that the next poll opens it again in case the device went away
+        if (active_transport->is_connected() == 1)
+        {
+            active_transport->disconnect(true);
+        }
+
+        if (upload_verify_schedule() == true)
+        {
+            return false;
+        }
+
+        fputs(qPrintable(tr("Device did not return after the reset") % newline), stdout);
+        command_exit_code = EXIT_CODE_VERIFY_FAILED;
+
+        return true;
+    }
+
+    //Every image which was marked must now be in an active slot
+    while (i < upload_mark_hashes.length())
+    {
+        uint8_t c = 0;
+        bool active = false;
+
+        while (c < img_mgmt_get_state_images->length() && active == false)
+        {
+            uint8_t m = 0;
+
+            while (m < (*img_mgmt_get_state_images)[c].slot_list.length())
+            {
+                if ((*img_mgmt_get_state_images)[c].slot_list[m].active == true && (*img_mgmt_get_state_images)[c].slot_list[m].hash == upload_mark_hashes[i])
+                {
+                    active = true;
+                    break;
+                }
+
+                ++m;
+            }
+
+            ++c;
+        }
+
+        if (active == true)
+        {
+            ++found;
+        }
+
+        ++i;
+    }
+
+    delete img_mgmt_get_state_images;
+    img_mgmt_get_state_images = nullptr;
+
+    fputs(qPrintable(tr("Reset to ready: ") % QString::number(upload_reset_timer.elapsed()) % "ms" % newline), stdout);
+
+    if (found != upload_mark_hashes.length())
+    {
+        fputs(qPrintable(tr("Device is not running the new image, it may have been reverted by the bootloader") % newline), stdout);
+        command_exit_code = EXIT_CODE_VERIFY_FAILED;
+
+        return true;
+    }
+
+    fputs(qPrintable(tr("Device is running the new image") % newline), stdout);
+
+    if (upload_verify_confirm == true && upload_mark_hashes.isEmpty() == false)
+    {
+        //Confirm each image in turn, status() starts the next once the previous has been confirmed
+        mode = ACTION_IMG_UPLOAD_CONFIRM;
+        upload_mark_index = 1;
+        upload_hash = upload_mark_hashes[0];
+        set_group_transport_settings(group_img);
+
+        if (group_img->start_image_set(&upload_hash, true, nullptr) == true)
+        {
+            return false;
+        }
+
+        command_exit_code = EXIT_CODE_VERIFY_FAILED;
+    }
+
+    return true;
+}
+
+void command_processor::upload_state_save()
+{
+    QSettings settings("qtmgmt", "qtmgmt");
+    QFileInfo file_info(upload_file);
+
+    //File size and modification time are kept so that a rebuilt file at the same path is not treated as the same upload
+    settings.setValue("upload/file", upload_file);
+    settings.setValue("upload/size", file_info.size());
+    settings.setValue("upload/modified", file_info.lastModified().toMSecsSinceEpoch());
+    settings.setValue("upload/image", upload_image);
+    settings.setValue("upload/transport", upload_transport);
+    settings.setValue("upload/hash", upload_hash.toHex());
+    settings.setValue("upload/progress", upload_progress);
+    settings.sync();
+}
+
+void command_processor::upload_state_clear()
+{
+    QSettings settings("qtmgmt", "qtmgmt");
+
+    settings.remove("upload");
+    settings.sync();
+}
+
+bool command_processor::upload_image_present(const QByteArray &hash, uint32_t image, bool *active, bool *pending, bool *confirmed)
+{
+    //Separate group so that the image state response does not go through status()
+    smp_group_img_mgmt query_group(processor);
+    QList<image_state_t> images;
+    uint8_t header_version = 0xff;
+    uint8_t i = 0;
+
+    query_group.set_parameters(smp_v2, smp_mtu, active_transport->get_retries(), active_transport->get_timeout(), ACTION_IMG_IMAGE_LIST);
+
+    if (query_group.start_image_get(&images) == false || wait_for_group(&query_group, &header_version) != STATUS_COMPLETE)
+    {
+        return false;
+    }
+
+    while (i < images.length())
+    {
+        if ((images[i].image_set == true ? images[i].image : i) == image)
+        {
+            uint8_t c = 0;
+
+            while (c < images[i].slot_list.length())
+            {
+                if (images[i].slot_list[c].hash == hash)
+                {
+                    *active = images[i].slot_list[c].active;
+                    *pending = images[i].slot_list[c].pending;
+                    *confirmed = images[i].slot_list[c].confirmed;
+
+                    return true;
+                }
+
+                ++c;
+            }
+        }
+
+        ++i;
+    }
+
+    return false;
+}
+
+bool command_processor::upload_state_matches(const QString &file_name, uint32_t image)
+{
+    QSettings settings("qtmgmt", "qtmgmt");
+    QFileInfo file_info(file_name);
+
+    if (settings.contains("upload/file") == false)
+    {
+        return false;
+    }
+
+    return (settings.value("upload/file").toString() == file_name && settings.value("upload/size").toLongLong() == file_info.size() && settings.value("upload/modified").toLongLong() == file_info.lastModified().toMSecsSinceEpoch() && settings.value("upload/image").toUInt() == image && settings.value("upload/transport").toString() == upload_transport);
+}
+
+void command_processor::slot_info_cache_max_image_size(uint32_t image, uint32_t max_image_size)
+{
+    QSettings settings("qtmgmt", "qtmgmt");
+
+    settings.setValue("slot_info/image_" % QString::number(image) % "/max_image_size", max_image_size);
+    settings.sync();
+}
+
+bool command_processor::slot_info_cached_max_image_size(uint32_t image, uint32_t *max_image_size)
+{
+    QSettings settings("qtmgmt", "qtmgmt");
+    QString key = "slot_info/image_" % QString::number(image) % "/max_image_size";
+
+    if (settings.contains(key) == false)
+    {
+        return false;
+    }
+
+    *max_image_size = settings.value(key).toUInt();
+
+    return true;
 }
 
 void command_processor::transport_disconnected()
 {
+    if (mode == ACTION_IMG_UPLOAD_VERIFY)
+    {
+        //A connection attempt which failed is started again by the next poll
+        upload_verify_connecting = false;
+    }
 }
 
 void command_processor::size_abbreviation(uint32_t size, QString *output)
@@ -28,6 +28,7 @@
 /******************************************************************************/
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QCommandLineParser>
 #include <smp_group_enum_mgmt.h>
 #include <smp_group_fs_mgmt.h>
@@ -54,6 +55,9 @@
 #include <QWaitCondition>
 #include "text_thread.h"
 #include "globals.h"
+#include "rtt_estimator.h"
+#include "signal_handler.h"
+#include "mcuboot_image.h"
 
 /******************************************************************************/
 // Enum typedefs
@@ -64,6 +68,8 @@ enum mcumgr_action_t {
     ACTION_IMG_UPLOAD,
     ACTION_IMG_UPLOAD_SET,
     ACTION_OS_UPLOAD_RESET,
+    ACTION_IMG_UPLOAD_VERIFY,
+    ACTION_IMG_UPLOAD_CONFIRM,
     ACTION_IMG_IMAGE_LIST,
     ACTION_IMG_IMAGE_SET,
     ACTION_IMG_IMAGE_ERASE,
@@ -120,6 +126,9 @@ enum exit_code_t {
     EXIT_CODE_ARGUMENT_VALUE_NOT_VALID = -8,
     EXIT_CODE_TRANSPORT_OPEN_FAILED = -9,
     EXIT_CODE_TODO_AA,
+    EXIT_CODE_INTERRUPTED = -10,
+    EXIT_CODE_VERIFY_FAILED = -11,
+    EXIT_CODE_IMAGE_INVALID = -12,
 };
 
 enum image_upload_mode_t {
@@ -130,6 +139,12 @@ enum image_upload_mode_t {
     IMAGE_UPLOAD_MODE_COUNT
 };
 
+enum image_upload_stage_t {
+    IMAGE_UPLOAD_STAGE_STARTED,
+    IMAGE_UPLOAD_STAGE_FINISHED,
+    IMAGE_UPLOAD_STAGE_FAILED
+};
+
 /******************************************************************************/
 // Class definitions
 /******************************************************************************/
@@ -152,6 +167,10 @@ private slots:
     void interactive_thread_data(QString data);
     void interactive_mode();
     void return_status(int status);
+    void transport_round_trip_sample(uint32_t rtt_us);
+    void transport_request_retry();
+    void terminate_requested(int signal_number);
+    void upload_verify_poll();
 
 signals:
 
@@ -181,9 +200,27 @@ private:
 
     void set_group_transport_settings(smp_group *group);
     void set_group_transport_settings(smp_group *group, uint32_t timeout);
+    void set_group_transport_settings(smp_group *group, uint32_t timeout, uint8_t retries);
+    void negotiate_link_parameters();
+    group_status wait_for_group(smp_group *group, uint8_t *header_version);
+    void request_given_up(group_status status);
 
     void size_abbreviation(uint32_t size, QString *output);
 
+    void upload_state_save();
+    void upload_state_clear();
+    bool upload_state_matches(const QString &file_name, uint32_t image);
+    bool upload_image_present(const QByteArray &hash, uint32_t image, bool *active, bool *pending, bool *confirmed);
+    enum image_upload_stage_t upload_start_image();
+    enum image_upload_stage_t upload_next_image();
+    enum image_upload_stage_t upload_mark_next_image();
+    bool upload_start_reset();
+    bool upload_verify_response(group_status status);
+    bool upload_verify_schedule();
+    void slot_info_cache_max_image_size(uint32_t image, uint32_t max_image_size);
+    bool slot_info_cached_max_image_size(uint32_t image, uint32_t *max_image_size);
+    bool inspect_image_file(const QString &file_name, uint32_t image);
+
     smp_processor *processor;
 
     smp_group_enum_mgmt *group_enum;
@@ -213,6 +250,15 @@ private:
     mcumgr_action_t mode;
     bool smp_v2;
     uint16_t smp_mtu;
+    bool smp_mtu_auto;
+    bool smp_version_set;
+
+    //Adaptive timeouts, the group, minimum timeout and retries of the command in progress are kept so that they can be updated
+    rtt_estimator round_trip_estimator;
+    bool adaptive_timeout;
+    smp_group *timeout_group;
+    uint32_t timeout_floor_ms;
+    uint8_t timeout_retries;
 
     //Enumeration management
     uint16_t enum_mgmt_count;
@@ -241,6 +287,31 @@ private:
     enum image_upload_mode_t upload_mode;
     QByteArray upload_hash;
     bool upload_reset;
+    QString upload_file;
+    uint32_t upload_image;
+    QString upload_transport;
+    uint8_t upload_progress;
+    bool upload_upgrade;
+    bool upload_resume;
+    bool upload_skip_if_present;
+
+    //Multi-image updates, each file is uploaded in turn, then the images are marked and the device reset once
+    QStringList upload_files;
+    QList<uint32_t> upload_images;
+    QList<QByteArray> upload_mark_hashes;
+    QList<QByteArray> upload_pending_hashes;
+    uint8_t upload_index;
+    uint8_t upload_mark_index;
+
+    //Verification of the running image once the device is back after the reset
+    bool upload_verify;
+    bool upload_verify_confirm;
+    uint32_t upload_verify_timeout_ms;
+    uint32_t upload_verify_delay_ms;
+    QElapsedTimer upload_reset_timer;
+    QTimer upload_verify_timer;
+    bool upload_verify_connecting;
+    int command_exit_code;
 
     //Shell management
     int32_t shell_mgmt_rc;
@@ -259,7 +330,25 @@ private:
     const uint16_t minimum_smp_mtu = 96;
     const uint16_t maximum_smp_mtu = 16384;
 
+    //Echo probing is capped so that a device which drops oversized messages does not take too long to search
+    const uint16_t maximum_smp_mtu_probe = 4096;
+    //SMP header, CBOR map with "d" key and text string header of an echo request, the response is the same size
+    const uint8_t smp_echo_overhead = 14;
+    //Length prefix and CRC16 of a UART frame, which the device's receive buffer holds along with the message
+    const uint8_t smp_uart_frame_overhead = 4;
+
+    const uint8_t maximum_upload_images = 8;
+
+    //Polls back off from the initial to the maximum delay, each poll is an image state request with the transport retries,
+    //verify_poll_timeout_ms is the minimum timeout of each attempt, a longer adaptive or transport timeout takes precedence
+    const uint16_t verify_poll_initial_ms = 250;
+    const uint16_t verify_poll_maximum_ms = 4000;
+    const uint16_t verify_poll_timeout_ms = 1500;
+    const uint16_t default_verify_timeout_s = 60;
+    const uint16_t maximum_verify_timeout_s = 3600;
+
     const uint32_t default_transport_uart_baud = 115200;
+    const uint16_t maximum_transport_uart_line_gap = 100;
     const uint16_t default_transport_udp_port = 1337;
     const uint16_t default_transport_lorawan_port = 1883;
     const uint16_t default_transport_lorawan_port_ssl = 8883;
@@ -330,6 +419,8 @@ private:
     void add_group_img_command_erase_slot(QList<entry_t> *entries);
     int run_group_img_command_erase_slot(QCommandLineParser *parser);
     int run_group_img_command_slot_info(QCommandLineParser *parser);
+    void add_group_img_command_inspect(QList<entry_t> *entries);
+    int run_group_img_command_inspect(QCommandLineParser *parser);
 
     //void add_group_os_command_(QList<entry_t> *entries);
     //int run_group_os_command_(QCommandLineParser *parser);
@@ -339,6 +430,8 @@ private:
         QStringList arguments;
         add_command_t add_function;
         run_command_t run_function;
+        //Local commands only work on files, no transport is needed
+        bool local = false;
     };
 
     struct supported_group_t {
@@ -382,7 +475,8 @@ private:
                {"Set image state", {"set-state"}, &command_processor::add_group_img_command_set_state, &command_processor::run_group_img_command_set_state},
                {"Upload firmware update", {"upload"}, &command_processor::add_group_img_command_upload, &command_processor::run_group_img_command_upload},
                {"Erase slot", {"erase"}, &command_processor::add_group_img_command_erase_slot, &command_processor::run_group_img_command_erase_slot},
-               {"Get information on slots", {"slot-info"}, nullptr, &command_processor::run_group_img_command_slot_info}
+               {"Get information on slots", {"slot-info"}, nullptr, &command_processor::run_group_img_command_slot_info},
+               {"Inspect and verify image file(s) locally", {"inspect"}, &command_processor::add_group_img_command_inspect, &command_processor::run_group_img_command_inspect, true}
             }
         },
         {"Operating system management", {"os"}, SMP_GROUP_ID_OS, group_os,
@@ -434,6 +528,8 @@ private:
 
     text_thread text_thread_object;
     bool is_interactive_mode;
+    signal_handler termination_handler;
+    QString session_transport;
 };
 
 #endif // COMMAND_PROCESSOR_H
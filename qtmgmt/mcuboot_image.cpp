@@ -0,0 +1,308 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  mcuboot_image.cpp
+**
+** Notes:   All multi-byte fields of MCUboot images are little endian
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "mcuboot_image.h"
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static uint16_t read_uint16(const uint8_t *data)
+{
+    return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+}
+
+static uint32_t read_uint32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+mcuboot_image::mcuboot_image()
+{
+    image_load_address = 0;
+    image_header_size = 0;
+    protected_tlv_size = 0;
+    image_body_size = 0;
+    image_flags = 0;
+    image_version = {0, 0, 0, 0};
+    image_total_size = 0;
+    image_hash_type = 0;
+}
+
+mcuboot_image::~mcuboot_image()
+{
+    file_data.clear();
+}
+
+enum mcuboot_image_error_t mcuboot_image::load(QString file_name)
+{
+    uchar *mapping;
+
+    //Release any previous mapping before the file is reused
+    file_data.clear();
+    image_file.close();
+    image_file.setFileName(file_name);
+
+    if (image_file.open(QIODevice::ReadOnly) == false)
+    {
+        return MCUBOOT_IMAGE_ERROR_FILE_OPEN;
+    }
+
+    mapping = (image_file.size() > 0 ? image_file.map(0, image_file.size()) : nullptr);
+
+    if (mapping == nullptr)
+    {
+        //Not all files can be mapped (e.g. pipes), these are read instead
+        return parse(image_file.readAll());
+    }
+
+    return parse(QByteArray::fromRawData((const char *)mapping, image_file.size()));
+}
+
+enum mcuboot_image_error_t mcuboot_image::parse(const QByteArray &image_data)
+{
+    const uint8_t *header = (const uint8_t *)image_data.constData();
+    enum mcuboot_image_error_t result;
+    uint32_t offset;
+    uint32_t area_size;
+
+    file_data = image_data;
+    image_hash.clear();
+    image_hash_type = 0;
+    image_total_size = 0;
+
+    //struct image_header from bootutil/image.h
+    if (image_data.length() < mcuboot_image_header_size_minimum)
+    {
+        return MCUBOOT_IMAGE_ERROR_TOO_SHORT;
+    }
+
+    if (read_uint32(&header[0]) != mcuboot_image_magic)
+    {
+        return MCUBOOT_IMAGE_ERROR_BAD_MAGIC;
+    }
+
+    image_load_address = read_uint32(&header[4]);
+    image_header_size = read_uint16(&header[8]);
+    protected_tlv_size = read_uint16(&header[10]);
+    image_body_size = read_uint32(&header[12]);
+    image_flags = read_uint32(&header[16]);
+    image_version.major = header[20];
+    image_version.minor = header[21];
+    image_version.revision = read_uint16(&header[22]);
+    image_version.build = read_uint32(&header[24]);
+
+    if (image_header_size < mcuboot_image_header_size_minimum || ((uint64_t)image_header_size + image_body_size) > (uint64_t)image_data.length())
+    {
+        return MCUBOOT_IMAGE_ERROR_BAD_HEADER;
+    }
+
+    offset = image_header_size + image_body_size;
+
+    if (protected_tlv_size > 0)
+    {
+        result = parse_tlv_area(offset, mcuboot_image_tlv_protected_info_magic, &area_size);
+
+        if (result != MCUBOOT_IMAGE_ERROR_OK)
+        {
+            return result;
+        }
+
+        if (area_size != protected_tlv_size)
+        {
+            return MCUBOOT_IMAGE_ERROR_BAD_TLV;
+        }
+
+        offset += area_size;
+    }
+
+    result = parse_tlv_area(offset, mcuboot_image_tlv_info_magic, &area_size);
+
+    if (result != MCUBOOT_IMAGE_ERROR_OK)
+    {
+        return result;
+    }
+
+    image_total_size = offset + area_size;
+
+    if (image_hash.isEmpty() == true)
+    {
+        return MCUBOOT_IMAGE_ERROR_NO_HASH;
+    }
+
+    return MCUBOOT_IMAGE_ERROR_OK;
+}
+
+enum mcuboot_image_error_t mcuboot_image::parse_tlv_area(uint32_t offset, uint16_t magic, uint32_t *area_size)
+{
+    const uint8_t *data = (const uint8_t *)file_data.constData();
+    uint32_t length = file_data.length();
+    uint32_t end;
+
+    //struct image_tlv_info followed by struct image_tlv entries, the total includes the info itself
+    if ((offset + 4) > length || read_uint16(&data[offset]) != magic)
+    {
+        return MCUBOOT_IMAGE_ERROR_BAD_TLV;
+    }
+
+    *area_size = read_uint16(&data[(offset + 2)]);
+    end = offset + *area_size;
+
+    if (*area_size < 4 || end > length)
+    {
+        return MCUBOOT_IMAGE_ERROR_BAD_TLV;
+    }
+
+    offset += 4;
+
+    while (offset < end)
+    {
+        uint16_t type;
+        uint16_t value_length;
+
+        if ((offset + 4) > end)
+        {
+            return MCUBOOT_IMAGE_ERROR_BAD_TLV;
+        }
+
+        type = read_uint16(&data[offset]);
+        value_length = read_uint16(&data[(offset + 2)]);
+        offset += 4;
+
+        if ((offset + value_length) > end)
+        {
+            return MCUBOOT_IMAGE_ERROR_BAD_TLV;
+        }
+
+        if (magic == mcuboot_image_tlv_info_magic && (type == mcuboot_image_tlv_sha256 || type == mcuboot_image_tlv_sha384 || type == mcuboot_image_tlv_sha512))
+        {
+            image_hash_type = type;
+            //Copied so that the hash does not refer to a mapped file
+            image_hash = QByteArray((const char *)&data[offset], value_length);
+        }
+
+        offset += value_length;
+    }
+
+    return MCUBOOT_IMAGE_ERROR_OK;
+}
+
+QString mcuboot_image::error_string(enum mcuboot_image_error_t error)
+{
+    switch (error)
+    {
+        case MCUBOOT_IMAGE_ERROR_OK:
+        {
+            return "No error";
+        }
+        case MCUBOOT_IMAGE_ERROR_FILE_OPEN:
+        {
+            return "File could not be opened";
+        }
+        case MCUBOOT_IMAGE_ERROR_TOO_SHORT:
+        {
+            return "File is too short for an image header";
+        }
+        case MCUBOOT_IMAGE_ERROR_BAD_MAGIC:
+        {
+            return "Not an MCUboot image (bad header magic)";
+        }
+        case MCUBOOT_IMAGE_ERROR_BAD_HEADER:
+        {
+            return "Image header sizes exceed the file";
+        }
+        case MCUBOOT_IMAGE_ERROR_BAD_TLV:
+        {
+            return "TLV area is missing or malformed";
+        }
+        case MCUBOOT_IMAGE_ERROR_NO_HASH:
+        {
+            return "No image hash TLV";
+        }
+        default:
+        {
+            return "Unhandled error code";
+        }
+    };
+}
+
+uint32_t mcuboot_image::load_address()
+{
+    return image_load_address;
+}
+
+uint16_t mcuboot_image::header_size()
+{
+    return image_header_size;
+}
+
+uint32_t mcuboot_image::image_size()
+{
+    return image_body_size;
+}
+
+uint32_t mcuboot_image::flags()
+{
+    return image_flags;
+}
+
+struct mcuboot_image_version_t mcuboot_image::version()
+{
+    return image_version;
+}
+
+QString mcuboot_image::version_string()
+{
+    return QString("%1.%2.%3+%4").arg(QString::number(image_version.major), QString::number(image_version.minor), QString::number(image_version.revision), QString::number(image_version.build));
+}
+
+uint32_t mcuboot_image::total_size()
+{
+    return image_total_size;
+}
+
+uint32_t mcuboot_image::hashed_size()
+{
+    return image_header_size + image_body_size + protected_tlv_size;
+}
+
+uint16_t mcuboot_image::hash_type()
+{
+    return image_hash_type;
+}
+
+const QByteArray &mcuboot_image::hash()
+{
+    return image_hash;
+}
+
+const QByteArray &mcuboot_image::data()
+{
+    return file_data;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
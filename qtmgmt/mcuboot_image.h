@@ -0,0 +1,133 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  mcuboot_image.h
+**
+** Notes:   Parser for MCUboot image files (header, protected and unprotected
+**          TLV areas), used to inspect images locally before uploading
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef MCUBOOT_IMAGE_H
+#define MCUBOOT_IMAGE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <stdint.h>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const uint32_t mcuboot_image_magic = 0x96f3b83d;
+const uint16_t mcuboot_image_tlv_info_magic = 0x6907;
+const uint16_t mcuboot_image_tlv_protected_info_magic = 0x6908;
+const uint8_t mcuboot_image_header_size_minimum = 32;
+
+const uint16_t mcuboot_image_tlv_sha256 = 0x10;
+const uint16_t mcuboot_image_tlv_sha384 = 0x11;
+const uint16_t mcuboot_image_tlv_sha512 = 0x12;
+
+const uint32_t mcuboot_image_flag_pic = 0x01;
+const uint32_t mcuboot_image_flag_encrypted_aes128 = 0x04;
+const uint32_t mcuboot_image_flag_encrypted_aes256 = 0x08;
+const uint32_t mcuboot_image_flag_non_bootable = 0x10;
+const uint32_t mcuboot_image_flag_ram_load = 0x20;
+
+/******************************************************************************/
+// Enum typedefs
+/******************************************************************************/
+enum mcuboot_image_error_t {
+    MCUBOOT_IMAGE_ERROR_OK = 0,
+    MCUBOOT_IMAGE_ERROR_FILE_OPEN,
+    MCUBOOT_IMAGE_ERROR_TOO_SHORT,
+    MCUBOOT_IMAGE_ERROR_BAD_MAGIC,
+    MCUBOOT_IMAGE_ERROR_BAD_HEADER,
+    MCUBOOT_IMAGE_ERROR_BAD_TLV,
+    MCUBOOT_IMAGE_ERROR_NO_HASH,
+
+    MCUBOOT_IMAGE_ERROR_COUNT
+};
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+struct mcuboot_image_version_t {
+    uint8_t major;
+    uint8_t minor;
+    uint16_t revision;
+    uint32_t build;
+};
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class mcuboot_image
+{
+public:
+    mcuboot_image();
+    ~mcuboot_image();
+
+    //Files are memory mapped where possible, data() then refers to the mapping and is only valid whilst this object exists
+    enum mcuboot_image_error_t load(QString file_name);
+    enum mcuboot_image_error_t parse(const QByteArray &image_data);
+
+    static QString error_string(enum mcuboot_image_error_t error);
+
+    uint32_t load_address();
+    uint16_t header_size();
+    uint32_t image_size();
+    uint32_t flags();
+    struct mcuboot_image_version_t version();
+    QString version_string();
+
+    //Size of the whole file as it will be written to the slot, header, image and both TLV areas
+    uint32_t total_size();
+
+    //Region covered by the image hash, the header, image and protected TLV area
+    uint32_t hashed_size();
+
+    //Hash TLV which the bootloader (and img_mgmt image state) reports for the image
+    uint16_t hash_type();
+    const QByteArray &hash();
+
+    const QByteArray &data();
+
+private:
+    enum mcuboot_image_error_t parse_tlv_area(uint32_t offset, uint16_t magic, uint32_t *area_size);
+
+    //Declared before file_data so that the mapping outlives it
+    QFile image_file;
+    QByteArray file_data;
+    uint32_t image_load_address;
+    uint16_t image_header_size;
+    uint16_t protected_tlv_size;
+    uint32_t image_body_size;
+    uint32_t image_flags;
+    struct mcuboot_image_version_t image_version;
+    uint32_t image_total_size;
+    uint16_t image_hash_type;
+    QByteArray image_hash;
+};
+
+#endif // MCUBOOT_IMAGE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -16,6 +16,10 @@ SOURCES += \
 	command_processor.cpp \
 	globals.cpp \
 	main.cpp \
+	mcuboot_image.cpp \
+	rtt_estimator.cpp \
+	sha256.cpp \
+	signal_handler.cpp \
 	text_thread.cpp
 
 HEADERS += \
@@ -36,10 +40,19 @@ HEADERS += \
     ../mcumgr/AuTerm/plugins/mcumgr/smp_processor.h \
     ../mcumgr/AuTerm/plugins/mcumgr/smp_transport.h \
     ../mcumgr/AuTerm/plugins/mcumgr/smp_group.h \
+    ../mcumgr/cpu_features.h \
     ../mcumgr/smp_uart.h \
+    ../mcumgr/smp_uart_framer.h \
+    ../mcumgr/smp_uart_framer_console.h \
+    ../mcumgr/smp_uart_message_queue.h \
+    ../mcumgr/smp_uart_worker.h \
     command_processor.h \
     globals.h \
+    mcuboot_image.h \
     qtmgmt.h \
+    rtt_estimator.h \
+    sha256.h \
+    signal_handler.h \
     text_thread.h
 
 #    ../mcumgr/AuTerm/plugins/mcumgr/smp_json.h \
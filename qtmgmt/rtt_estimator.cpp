@@ -0,0 +1,142 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  rtt_estimator.cpp
+**
+** Notes:   Smoothed round trip time and retransmission timeout (Jacobson/Karn)
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "rtt_estimator.h"
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+//Bounds of the calculated timeout, the lower bound is the 1 second of RFC 6298 which also allows for occasional slow operations such as flash
+//page erases
+static const uint32_t timeout_minimum_ms = 1000;
+static const uint32_t timeout_maximum_ms = 60000;
+static const uint32_t clock_granularity_us = 1000;
+static const uint8_t backoff_shift_maximum = 6;
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+rtt_estimator::rtt_estimator()
+{
+    reset();
+}
+
+void rtt_estimator::reset()
+{
+    sample_count = 0;
+    srtt_us = 0;
+    rttvar_us = 0;
+    backoff_shift = 0;
+}
+
+void rtt_estimator::add_sample(uint32_t rtt_us)
+{
+    if (sample_count == 0)
+    {
+        srtt_us = rtt_us;
+        rttvar_us = rtt_us / 2;
+    }
+    else
+    {
+        //RFC 6298: RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+        uint32_t difference = (srtt_us > rtt_us ? (srtt_us - rtt_us) : (rtt_us - srtt_us));
+
+        rttvar_us = (uint32_t)((((uint64_t)rttvar_us * 3) + difference) / 4);
+        srtt_us = (uint32_t)((((uint64_t)srtt_us * 7) + rtt_us) / 8);
+    }
+
+    ++sample_count;
+    backoff_shift = 0;
+}
+
+void rtt_estimator::backoff()
+{
+    //RFC 6298 section 5.5, kept until a new sample has been taken
+    if (backoff_shift < backoff_shift_maximum)
+    {
+        ++backoff_shift;
+    }
+}
+
+uint32_t rtt_estimator::timeout_ms(uint32_t fallback_ms, uint32_t floor_ms)
+{
+    uint64_t timeout;
+
+    if (sample_count == 0)
+    {
+        timeout = fallback_ms;
+    }
+    else
+    {
+        //RTO = SRTT + max(G, 4 * RTTVAR)
+        uint64_t variation = (uint64_t)rttvar_us * 4;
+
+        timeout = ((uint64_t)srtt_us + (variation > clock_granularity_us ? variation : clock_granularity_us) + 999) / 1000;
+
+        if (timeout < timeout_minimum_ms)
+        {
+            timeout = timeout_minimum_ms;
+        }
+        else if (timeout > timeout_maximum_ms)
+        {
+            timeout = timeout_maximum_ms;
+        }
+    }
+
+    if (backoff_shift > 0)
+    {
+        //A fallback above the maximum is never reduced by backing off
+        uint64_t maximum = (timeout > timeout_maximum_ms ? timeout : timeout_maximum_ms);
+
+        timeout <<= backoff_shift;
+
+        if (timeout > maximum)
+        {
+            timeout = maximum;
+        }
+    }
+
+    return (uint32_t)(timeout > floor_ms ? timeout : floor_ms);
+}
+
+uint32_t rtt_estimator::samples()
+{
+    return sample_count;
+}
+
+uint32_t rtt_estimator::smoothed_rtt_us()
+{
+    return srtt_us;
+}
+
+uint32_t rtt_estimator::rtt_variation_us()
+{
+    return rttvar_us;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,64 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  rtt_estimator.h
+**
+** Notes:   Smoothed round trip time and retransmission timeout (Jacobson/Karn)
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class rtt_estimator
+{
+public:
+    rtt_estimator();
+    void reset();
+
+    //Samples must only come from requests which were not retransmitted (Karn's algorithm), a sample also ends any backoff
+    void add_sample(uint32_t rtt_us);
+
+    //Doubles the timeout after a request timed out, up to the maximum
+    void backoff();
+
+    //Timeout to use for the next request, fallback_ms is used until there are samples, never less than floor_ms
+    uint32_t timeout_ms(uint32_t fallback_ms, uint32_t floor_ms);
+
+    uint32_t samples();
+    uint32_t smoothed_rtt_us();
+    uint32_t rtt_variation_us();
+
+private:
+    uint32_t sample_count;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint8_t backoff_shift;
+};
+
+#endif // RTT_ESTIMATOR_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
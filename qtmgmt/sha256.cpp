@@ -0,0 +1,259 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  sha256.cpp
+**
+** Notes:   Implementation follows FIPS 180-4, the SHA-NI path is selected at
+**          runtime and processes the same blocks as the portable path
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "sha256.h"
+#include "cpu_features.h"
+#include <string.h>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+static const uint8_t sha256_block_size = 64;
+
+static const uint32_t sha256_initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t sha256_round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static inline uint32_t rotate_right(uint32_t value, uint8_t count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+
+static inline uint32_t read_uint32_be(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static void sha256_blocks(uint32_t *state, const uint8_t *data, uint64_t blocks)
+{
+    uint32_t schedule[64];
+
+    while (blocks > 0)
+    {
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+        uint32_t f = state[5];
+        uint32_t g = state[6];
+        uint32_t h = state[7];
+        uint8_t i = 0;
+
+        while (i < 16)
+        {
+            schedule[i] = read_uint32_be(&data[(i * 4)]);
+            ++i;
+        }
+
+        while (i < 64)
+        {
+            uint32_t s0 = rotate_right(schedule[(i - 15)], 7) ^ rotate_right(schedule[(i - 15)], 18) ^ (schedule[(i - 15)] >> 3);
+            uint32_t s1 = rotate_right(schedule[(i - 2)], 17) ^ rotate_right(schedule[(i - 2)], 19) ^ (schedule[(i - 2)] >> 10);
+
+            schedule[i] = schedule[(i - 16)] + s0 + schedule[(i - 7)] + s1;
+            ++i;
+        }
+
+        i = 0;
+
+        while (i < 64)
+        {
+            uint32_t t1 = h + (rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25)) + ((e & f) ^ (~e & g)) + sha256_round_constants[i] + schedule[i];
+            uint32_t t2 = (rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+            ++i;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+
+        data += sha256_block_size;
+        --blocks;
+    }
+}
+
+#if defined(CPU_FEATURES_X86)
+//State is kept as ABEF/CDGH pairs, which is the layout sha256rnds2 operates on
+CPU_FEATURES_TARGET("sha,sse4.1")
+static void sha256_blocks_shani(uint32_t *state, const uint8_t *data, uint64_t blocks)
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i temp = _mm_loadu_si128((const __m128i *)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+    __m128i state0;
+
+    temp = _mm_shuffle_epi32(temp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    state0 = _mm_alignr_epi8(temp, state1, 8);
+    state1 = _mm_blend_epi16(state1, temp, 0xf0);
+
+    while (blocks > 0)
+    {
+        __m128i saved0 = state0;
+        __m128i saved1 = state1;
+        __m128i message[4];
+        __m128i value;
+        uint8_t i = 0;
+
+        while (i < 4)
+        {
+            message[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&data[(i * 16)]), byte_swap);
+            ++i;
+        }
+
+        //Each pass runs four rounds, the schedule for later rounds is built in place from the previous four words
+        i = 0;
+
+        while (i < 16)
+        {
+            __m128i *current = &message[(i & 3)];
+
+            if (i >= 4)
+            {
+                *current = _mm_sha256msg1_epu32(*current, message[((i + 1) & 3)]);
+                *current = _mm_add_epi32(*current, _mm_alignr_epi8(message[((i + 3) & 3)], message[((i + 2) & 3)], 4));
+                *current = _mm_sha256msg2_epu32(*current, message[((i + 3) & 3)]);
+            }
+
+            value = _mm_add_epi32(*current, _mm_loadu_si128((const __m128i *)&sha256_round_constants[(i * 4)]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, value);
+            value = _mm_shuffle_epi32(value, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, value);
+            ++i;
+        }
+
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+
+        data += sha256_block_size;
+        --blocks;
+    }
+
+    temp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(temp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, temp, 8);
+
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+#endif
+
+static void sha256_process(uint32_t *state, const uint8_t *data, uint64_t blocks)
+{
+#if defined(CPU_FEATURES_X86)
+    uint32_t features = cpu_features_get();
+
+    if ((features & (CPU_FEATURE_SHA | CPU_FEATURE_SSE4_1)) == (CPU_FEATURE_SHA | CPU_FEATURE_SSE4_1))
+    {
+        sha256_blocks_shani(state, data, blocks);
+        return;
+    }
+#endif
+
+    sha256_blocks(state, data, blocks);
+}
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+void sha256_calculate(const uint8_t *data, uint64_t length, uint8_t *digest)
+{
+    uint32_t state[8];
+    uint8_t final_blocks[(sha256_block_size * 2)];
+    uint64_t whole_blocks = length / sha256_block_size;
+    uint8_t remaining = length % sha256_block_size;
+    uint8_t final_size = (remaining < (sha256_block_size - 8) ? sha256_block_size : (sha256_block_size * 2));
+    uint64_t bit_length = length * 8;
+    uint8_t i = 0;
+
+    memcpy(state, sha256_initial_state, sizeof(state));
+
+    //Whole blocks are hashed straight from the input, which can be a mapped file
+    sha256_process(state, data, whole_blocks);
+
+    memset(final_blocks, 0, sizeof(final_blocks));
+
+    //data may be null for an empty input, which memcpy() does not allow even for a length of 0
+    if (remaining > 0)
+    {
+        memcpy(final_blocks, &data[(whole_blocks * sha256_block_size)], remaining);
+    }
+    final_blocks[remaining] = 0x80;
+
+    while (i < 8)
+    {
+        final_blocks[(final_size - 1 - i)] = (uint8_t)(bit_length >> (i * 8));
+        ++i;
+    }
+
+    sha256_process(state, final_blocks, (final_size / sha256_block_size));
+
+    i = 0;
+
+    while (i < 8)
+    {
+        digest[(i * 4)] = (uint8_t)(state[i] >> 24);
+        digest[((i * 4) + 1)] = (uint8_t)(state[i] >> 16);
+        digest[((i * 4) + 2)] = (uint8_t)(state[i] >> 8);
+        digest[((i * 4) + 3)] = (uint8_t)state[i];
+        ++i;
+    }
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
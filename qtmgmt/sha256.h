@@ -0,0 +1,47 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  sha256.h
+**
+** Notes:   SHA-256 used to check image hashes locally, the SHA extensions are
+**          used when the CPU supports them
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SHA256_H
+#define SHA256_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const uint8_t sha256_digest_size = 32;
+
+/******************************************************************************/
+// Global Functions or Non Class Members
+/******************************************************************************/
+//Hashes length bytes in one pass, digest must hold sha256_digest_size bytes
+void sha256_calculate(const uint8_t *data, uint64_t length, uint8_t *digest);
+
+#endif // SHA256_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,161 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  signal_handler.cpp
+**
+** Notes:   Unix signals are written to a socket pair from the handler, which
+**          is the only async-signal-safe way of waking the event loop
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "signal_handler.h"
+#include <signal.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+#ifdef WIN32
+static signal_handler *installed_handler = nullptr;
+
+//Runs on a thread created by the system, so the signal is queued to the handler's thread
+static BOOL WINAPI console_control_handler(DWORD control_type)
+{
+    if (installed_handler == nullptr || (control_type != CTRL_C_EVENT && control_type != CTRL_BREAK_EVENT && control_type != CTRL_CLOSE_EVENT))
+    {
+        return FALSE;
+    }
+
+    QMetaObject::invokeMethod(installed_handler, "deliver", Qt::QueuedConnection, Q_ARG(int, (control_type == CTRL_CLOSE_EVENT ? SIGTERM : SIGINT)));
+
+    return TRUE;
+}
+#else
+int signal_handler::pipe_handles[2] = { -1, -1 };
+#endif
+
+signal_handler::signal_handler(QObject *parent) : QObject{parent}
+{
+#ifndef WIN32
+    notifier = nullptr;
+#endif
+}
+
+signal_handler::~signal_handler()
+{
+#ifdef WIN32
+    if (installed_handler == this)
+    {
+        SetConsoleCtrlHandler(console_control_handler, FALSE);
+        installed_handler = nullptr;
+    }
+#else
+    if (notifier != nullptr)
+    {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+
+        delete notifier;
+        notifier = nullptr;
+
+        ::close(pipe_handles[0]);
+        ::close(pipe_handles[1]);
+        pipe_handles[0] = -1;
+        pipe_handles[1] = -1;
+    }
+#endif
+}
+
+bool signal_handler::install()
+{
+#ifdef WIN32
+    if (installed_handler != nullptr)
+    {
+        return false;
+    }
+
+    installed_handler = this;
+
+    return (SetConsoleCtrlHandler(console_control_handler, TRUE) != 0);
+#else
+    struct sigaction action;
+
+    if (pipe_handles[0] != -1 || socketpair(AF_UNIX, SOCK_STREAM, 0, pipe_handles) != 0)
+    {
+        return false;
+    }
+
+    notifier = new QSocketNotifier(pipe_handles[1], QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &signal_handler::notifier_activated);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signal_handler::handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    if (sigaction(SIGINT, &action, nullptr) != 0 || sigaction(SIGTERM, &action, nullptr) != 0)
+    {
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+#ifndef WIN32
+void signal_handler::handler(int signal_number)
+{
+    char data = (char)signal_number;
+    ssize_t written = ::write(pipe_handles[0], &data, sizeof(data));
+
+    Q_UNUSED(written);
+}
+#endif
+
+void signal_handler::notifier_activated()
+{
+#ifndef WIN32
+    char data;
+
+    notifier->setEnabled(false);
+
+    if (::read(pipe_handles[1], &data, sizeof(data)) == sizeof(data))
+    {
+        deliver((int)data);
+    }
+
+    notifier->setEnabled(true);
+#endif
+}
+
+void signal_handler::deliver(int signal_number)
+{
+    emit terminate_requested(signal_number);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,69 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  signal_handler.h
+**
+** Notes:   Turns SIGINT/SIGTERM (or console control events on Windows) into a
+**          Qt signal delivered on the main thread's event loop
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef SIGNAL_HANDLER_H
+#define SIGNAL_HANDLER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#ifndef WIN32
+#include <QSocketNotifier>
+#endif
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class signal_handler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit signal_handler(QObject *parent = nullptr);
+    ~signal_handler();
+
+    //Only one instance can be installed at a time
+    bool install();
+
+signals:
+    void terminate_requested(int signal_number);
+
+private slots:
+    void notifier_activated();
+    void deliver(int signal_number);
+
+private:
+#ifndef WIN32
+    static void handler(int signal_number);
+    static int pipe_handles[2];
+
+    QSocketNotifier *notifier;
+#endif
+};
+
+#endif // SIGNAL_HANDLER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
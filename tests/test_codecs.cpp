@@ -0,0 +1,396 @@
+/******************************************************************************
+** Copyright (C) 2025 Jamie M.
+**
+** Project: qtmgmt
+**
+** Module:  test_codecs.cpp
+**
+** Notes:   Tests of the Qt-free codecs: base64, CRC16, the UART framers and
+**          SHA-256, the accelerated paths are checked against the portable
+**          ones on CPUs which have the extensions
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QtTest>
+#include "cpu_features.h"
+#include "smp_uart_base64.h"
+#include "smp_uart_crc16.h"
+#include "smp_uart_framer.h"
+#include "smp_uart_framer_console.h"
+#include "sha256.h"
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+//Each test runs with all of the features the CPU has, without AVX2 (SSE paths), then with only the portable code
+const uint32_t disabled_feature_sets[] = {
+    0,
+    CPU_FEATURE_AVX2,
+    (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1 | CPU_FEATURE_AVX2 | CPU_FEATURE_SHA),
+};
+
+//Covers every tail length of the vector loops, and lengths spanning many iterations of them
+const uint32_t test_lengths[] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60,
+    61, 62, 63, 64, 65, 66, 67, 95, 96, 97, 127, 128, 129, 191, 192, 193, 253, 254, 255, 256, 257, 1000, 4099, 65535,
+};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static QByteArray test_data(uint32_t length, uint32_t seed)
+{
+    QByteArray data(length, 0);
+    uint32_t state = seed * 2654435761U + 1;
+    uint32_t i = 0;
+
+    while (i < length)
+    {
+        state = state * 1664525U + 1013904223U;
+        data[i] = (char)(state >> 24);
+        ++i;
+    }
+
+    return data;
+}
+
+static uint16_t crc16_bitwise(const QByteArray &data)
+{
+    uint16_t crc = 0;
+    int i = 0;
+
+    while (i < data.length())
+    {
+        uint8_t bit = 0;
+
+        crc ^= (uint16_t)((uint8_t)data[i] << 8);
+
+        while (bit < 8)
+        {
+            crc = ((crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1));
+            ++bit;
+        }
+
+        ++i;
+    }
+
+    return crc;
+}
+
+static QByteArray sha256_digest(const QByteArray &data)
+{
+    QByteArray digest(sha256_digest_size, 0);
+
+    sha256_calculate((const uint8_t *)data.constData(), data.length(), (uint8_t *)digest.data());
+
+    return digest;
+}
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class test_codecs : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void base64_encode_matches_reference();
+    void base64_decode_round_trip();
+    void base64_decode_rejects_invalid();
+    void crc16_matches_bitwise();
+    void framer_round_trip_data();
+    void framer_round_trip();
+    void framer_maximum_message_size_data();
+    void framer_maximum_message_size();
+    void sha256_known_vectors();
+    void sha256_accelerated_matches_portable();
+};
+
+void test_codecs::initTestCase()
+{
+    uint32_t features = cpu_features_get();
+
+    //Accelerated paths which the CPU does not have cannot be checked, the portable ones always are
+    qInfo() << "SSSE3+SSE4.1:" << ((features & (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1)) == (CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE4_1)) << "AVX2:" << ((features & CPU_FEATURE_AVX2) != 0) << "SHA:" << ((features & CPU_FEATURE_SHA) != 0);
+}
+
+void test_codecs::cleanup()
+{
+    cpu_features_disabled = 0;
+}
+
+void test_codecs::base64_encode_matches_reference()
+{
+    for (uint32_t disabled : disabled_feature_sets)
+    {
+        cpu_features_disabled = disabled;
+
+        for (uint32_t length : test_lengths)
+        {
+            QByteArray data = test_data(length, length);
+            QByteArray output(smp_uart_base64_encoded_size(length), 0);
+            uint32_t written = smp_uart_base64_encode((const uint8_t *)data.constData(), length, output.data());
+
+            QCOMPARE(written, smp_uart_base64_encoded_size(length));
+            QCOMPARE(output, data.toBase64());
+        }
+    }
+}
+
+void test_codecs::base64_decode_round_trip()
+{
+    for (uint32_t disabled : disabled_feature_sets)
+    {
+        cpu_features_disabled = disabled;
+
+        for (uint32_t length : test_lengths)
+        {
+            QByteArray data = test_data(length, length);
+            QByteArray padded = data.toBase64();
+            QByteArray unpadded = data.toBase64(QByteArray::Base64Encoding | QByteArray::OmitTrailingEquals);
+            QByteArray output(smp_uart_base64_decoded_size_maximum(padded.length()), 0);
+            int32_t read;
+
+            read = smp_uart_base64_decode(padded.constData(), padded.length(), (uint8_t *)output.data());
+            QCOMPARE(read, (int32_t)length);
+            QCOMPARE(output.left(read), data);
+
+            read = smp_uart_base64_decode(unpadded.constData(), unpadded.length(), (uint8_t *)output.data());
+            QCOMPARE(read, (int32_t)length);
+            QCOMPARE(output.left(read), data);
+        }
+    }
+}
+
+void test_codecs::base64_decode_rejects_invalid()
+{
+    QByteArray encoded = test_data(300, 1).toBase64();
+    QByteArray output(smp_uart_base64_decoded_size_maximum(encoded.length()), 0);
+
+    for (uint32_t disabled : disabled_feature_sets)
+    {
+        cpu_features_disabled = disabled;
+
+        //A single bad character anywhere must be caught, whichever path decodes that part of the input
+        for (int i = 0; i < encoded.length(); ++i)
+        {
+            for (char invalid : {'*', '-', '\0', '\x80', '\xff'})
+            {
+                QByteArray corrupt = encoded;
+
+                corrupt[i] = invalid;
+                QCOMPARE(smp_uart_base64_decode(corrupt.constData(), corrupt.length(), (uint8_t *)output.data()), -1);
+            }
+        }
+
+        //A final group of 1 character cannot hold a byte
+        QCOMPARE(smp_uart_base64_decode(encoded.constData(), 5, (uint8_t *)output.data()), -1);
+    }
+}
+
+void test_codecs::crc16_matches_bitwise()
+{
+    //Check value of CRC-16/XMODEM
+    QCOMPARE(smp_uart_crc16((const uint8_t *)"123456789", 9), (uint16_t)0x31c3);
+
+    for (uint32_t length : test_lengths)
+    {
+        QByteArray data = test_data(length, length);
+        uint16_t expected = crc16_bitwise(data);
+        uint32_t split = 0;
+
+        QCOMPARE(smp_uart_crc16((const uint8_t *)data.constData(), length), expected);
+
+        //Continuing over two spans gives the same result as one, wherever the split is
+        while (split <= length && split < 70)
+        {
+            uint16_t crc = smp_uart_crc16((const uint8_t *)data.constData(), split);
+
+            crc = smp_uart_crc16((const uint8_t *)&data.constData()[split], (length - split), crc);
+            QCOMPARE(crc, expected);
+            ++split;
+        }
+    }
+}
+
+void test_codecs::framer_round_trip_data()
+{
+    QTest::addColumn<int>("framing");
+    QTest::addColumn<int>("line_size");
+
+    QTest::newRow("console default") << (int)SMP_UART_FRAMING_CONSOLE << (int)smp_uart_line_size_default;
+    QTest::newRow("console minimum") << (int)SMP_UART_FRAMING_CONSOLE << (int)smp_uart_line_size_minimum;
+    QTest::newRow("console 1024") << (int)SMP_UART_FRAMING_CONSOLE << 1024;
+    QTest::newRow("cobs") << (int)SMP_UART_FRAMING_COBS << 0;
+}
+
+void test_codecs::framer_round_trip()
+{
+    QFETCH(int, framing);
+    QFETCH(int, line_size);
+
+    QScopedPointer<smp_uart_framer> encoder(smp_uart_framer_create((enum smp_uart_framing_t)framing, line_size));
+    QScopedPointer<smp_uart_framer> decoder(smp_uart_framer_create((enum smp_uart_framing_t)framing, line_size));
+    uint16_t message_size_maximum;
+    QList<QByteArray> messages;
+    QByteArray stream;
+    QByteArray framed;
+    uint32_t chunk_seed = 1;
+    int received = 0;
+    int pos = 0;
+
+    QVERIFY(encoder.isNull() == false);
+    QVERIFY(decoder.isNull() == false);
+
+    //Largest message which the framing can carry
+    message_size_maximum = encoder->maximum_message_size(encoder->encoded_size(UINT16_MAX));
+
+    for (uint32_t disabled : disabled_feature_sets)
+    {
+        cpu_features_disabled = disabled;
+
+        for (uint32_t length : test_lengths)
+        {
+            //SMP messages always have an 8 byte header
+            QByteArray data = test_data(((length + 8) > message_size_maximum ? message_size_maximum : (length + 8)), length);
+
+            encoder->encode((const uint8_t *)data.constData(), data.length(), &framed);
+
+            //COBS sizes are the worst case, console sizes are exact
+            if (framing == SMP_UART_FRAMING_COBS)
+            {
+                QVERIFY((uint32_t)framed.length() <= encoder->encoded_size(data.length()));
+            }
+            else
+            {
+                QCOMPARE((uint32_t)framed.length(), encoder->encoded_size(data.length()));
+            }
+
+            messages.append(data);
+            stream.append(framed);
+        }
+    }
+
+    //Received data arrives in arbitrary pieces which split frames anywhere
+    while (pos < stream.length())
+    {
+        uint32_t chunk;
+        const char *data;
+
+        chunk_seed = chunk_seed * 1664525U + 1013904223U;
+        chunk = 1 + ((chunk_seed >> 16) % 300);
+
+        if (chunk > (uint32_t)(stream.length() - pos))
+        {
+            chunk = stream.length() - pos;
+        }
+
+        data = &stream.constData()[pos];
+        pos += chunk;
+
+        while (chunk > 0)
+        {
+            bool message_complete = false;
+            uint32_t used = decoder->decode(data, chunk, &message_complete);
+
+            data += used;
+            chunk -= used;
+
+            if (message_complete == true)
+            {
+                QVERIFY(received < messages.length());
+                QCOMPARE(*decoder->message(), messages[received]);
+                ++received;
+            }
+        }
+    }
+
+    QCOMPARE(received, messages.length());
+    QCOMPARE(decoder->errors(), (uint32_t)0);
+}
+
+void test_codecs::framer_maximum_message_size_data()
+{
+    framer_round_trip_data();
+}
+
+void test_codecs::framer_maximum_message_size()
+{
+    QFETCH(int, framing);
+    QFETCH(int, line_size);
+
+    QScopedPointer<smp_uart_framer> framer(smp_uart_framer_create((enum smp_uart_framing_t)framing, line_size));
+    uint32_t encoded_length = 0;
+
+    QVERIFY(framer.isNull() == false);
+
+    //Largest message which fits, so the next size up must not
+    while (encoded_length < 3000)
+    {
+        uint16_t maximum = framer->maximum_message_size(encoded_length);
+
+        if (maximum > 0)
+        {
+            QVERIFY(framer->encoded_size(maximum) <= encoded_length);
+        }
+
+        QVERIFY(framer->encoded_size((maximum + 1)) > encoded_length);
+        ++encoded_length;
+    }
+}
+
+void test_codecs::sha256_known_vectors()
+{
+    //FIPS 180-2 test vectors
+    QByteArray million_a(1000000, 'a');
+
+    for (uint32_t disabled : disabled_feature_sets)
+    {
+        cpu_features_disabled = disabled;
+
+        QCOMPARE(sha256_digest(QByteArray()), QByteArray::fromHex("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"));
+        QCOMPARE(sha256_digest("abc"), QByteArray::fromHex("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+        QCOMPARE(sha256_digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"), QByteArray::fromHex("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+        QCOMPARE(sha256_digest(million_a), QByteArray::fromHex("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"));
+    }
+}
+
+void test_codecs::sha256_accelerated_matches_portable()
+{
+    for (uint32_t length : test_lengths)
+    {
+        QByteArray data = test_data(length, length);
+        QByteArray accelerated;
+
+        cpu_features_disabled = 0;
+        accelerated = sha256_digest(data);
+        cpu_features_disabled = CPU_FEATURE_SHA;
+        QCOMPARE(accelerated, sha256_digest(data));
+    }
+}
+
+QTEST_APPLESS_MAIN(test_codecs)
+
+#include "test_codecs.moc"
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
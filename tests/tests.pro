@@ -0,0 +1,30 @@
+include(../qtmgmt-includes.pri)
+
+QT = core testlib
+
+CONFIG += c++17 cmdline testcase
+
+TARGET = test_codecs
+
+# The codecs are built straight into the test so that it does not depend on the plugin or transports
+INCLUDEPATH    += ../mcumgr
+INCLUDEPATH    += ../mcumgr/AuTerm/plugins/mcumgr
+INCLUDEPATH    += ../qtmgmt
+
+SOURCES += \
+	../mcumgr/smp_uart_base64.cpp \
+	../mcumgr/smp_uart_crc16.cpp \
+	../mcumgr/smp_uart_framer.cpp \
+	../mcumgr/smp_uart_framer_cobs.cpp \
+	../mcumgr/smp_uart_framer_console.cpp \
+	../qtmgmt/sha256.cpp \
+	test_codecs.cpp
+
+HEADERS += \
+    ../mcumgr/cpu_features.h \
+    ../mcumgr/smp_uart_base64.h \
+    ../mcumgr/smp_uart_crc16.h \
+    ../mcumgr/smp_uart_framer.h \
+    ../mcumgr/smp_uart_framer_cobs.h \
+    ../mcumgr/smp_uart_framer_console.h \
+    ../qtmgmt/sha256.h